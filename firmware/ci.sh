@@ -33,3 +33,13 @@ if [ "$1" == "test-firmware" ]; then
     renode-run test --venv renode-test -- tests/simple_tests.robot
     renode-run test --venv renode-test -- tests/complex_tests.robot
 fi
+
+if [ "$1" == "benchmark-host" ]; then
+    $s apt -qy install cmake g++ > /dev/null 2> /dev/null
+    cmake -S tests/host -B tests/host/build
+    cmake --build tests/host/build
+    cd tests/host/build
+    ctest --output-on-failure
+    ./fram_buffer_benchmark
+    ./line_formatter_benchmark
+fi
@@ -0,0 +1,219 @@
+#include "compact_buffer.h"
+
+#include <zephyr/sys/crc.h>
+
+#include <cstring>
+#include <optional>
+
+namespace {
+constexpr int64_t fixed_point_factor = 1000000;
+
+// zigzag encoding keeps small negative values small
+size_t put_varint(uint8_t* out, int64_t value) {
+    uint64_t v = (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+    size_t size = 0;
+    do {
+        const uint8_t byte = v & 0x7f;
+        v >>= 7;
+        out[size++] = v ? byte | 0x80 : byte;
+    } while (v);
+    return size;
+}
+
+bool get_varint(const uint8_t* data, size_t size, size_t& offset, int64_t& value) {
+    uint64_t v = 0;
+    for (unsigned shift = 0; shift < 64 && offset < size; shift += 7) {
+        const uint8_t byte = data[offset++];
+        v |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            value = static_cast<int64_t>(v >> 1) ^ -static_cast<int64_t>(v & 1);
+            return true;
+        }
+    }
+    return false;
+}
+}
+
+compact_buffer::compact_buffer(addr_t begin, addr_t end, addr_t checkpoint_addr)
+    : m_open_addr{begin}, m_blocks{begin + open_block_size, end, checkpoint_addr} {
+    open_block_header headers[2];
+    fram::read(m_open_addr, headers);
+    fram::read_raw(open_data_addr(), m_open.data, sizeof(m_open.data));
+    std::optional<open_block_header> latest;
+    for (const open_block_header& h : headers) {
+        if (h.size > block_data_size || h.crc != open_header_crc(h, m_open.data)) {
+            continue;
+        }
+        if (!latest || static_cast<int32_t>(h.revision - latest->revision) > 0) {
+            latest = h;
+        }
+    }
+
+    const std::optional<block> last_block = m_blocks.back();
+    if (latest) {
+        m_open_revision = latest->revision;
+        m_oldest_sequence = latest->oldest_sequence;
+    } else {
+        const std::optional<block> first_block = m_blocks.front();
+        m_oldest_sequence = first_block ? first_block->first_sequence : 0;
+    }
+
+    // open block is already stored in fram_buffer if power was lost right after pushing it
+    if (latest && (!last_block || last_block->first_sequence != latest->first_sequence)) {
+        m_open.first_sequence = latest->first_sequence;
+        m_open.size = latest->size;
+        size_t offset = 0;
+        while (m_open.count < latest->count && decode_sample(m_open, offset, m_last)) {
+            m_open.count++;
+        }
+    } else {
+        m_open = block{.first_sequence = last_block ? last_block->first_sequence + last_block->count : 0};
+    }
+    write_open_header();
+}
+
+compact_buffer::crc_t compact_buffer::open_header_crc(const open_block_header& h, const uint8_t* data) {
+    const crc_t crc = crc32_ieee(reinterpret_cast<const uint8_t*>(&h), offsetof(open_block_header, crc));
+    return crc32_ieee_update(crc, data, h.size);
+}
+
+void compact_buffer::write_open_header() {
+    m_open_revision++;
+    open_block_header h{.revision = m_open_revision,
+                        .first_sequence = m_open.first_sequence,
+                        .oldest_sequence = m_oldest_sequence,
+                        .count = m_open.count,
+                        .size = m_open.size};
+    h.crc = open_header_crc(h, m_open.data);
+    fram::write(m_open_addr + (m_open_revision % 2) * sizeof(h), h);
+}
+
+compact_buffer::fields compact_buffer::to_fields(const sensors::data_point& p) {
+    fields f{p.timestamp_ms};
+    for (size_t i = 0; i < sensors::channel_count; i++) {
+        f[i + 1] = p.values[i].val1 * fixed_point_factor + p.values[i].val2;
+    }
+    return f;
+}
+
+sensors::data_point compact_buffer::to_data_point(const fields& f) {
+    sensors::data_point p{.timestamp_ms = f[0]};
+    for (size_t i = 0; i < sensors::channel_count; i++) {
+        p.values[i] = {.val1 = static_cast<int32_t>(f[i + 1] / fixed_point_factor),
+                       .val2 = static_cast<int32_t>(f[i + 1] % fixed_point_factor)};
+    }
+    return p;
+}
+
+size_t compact_buffer::encode_sample(const fields& f, const fields& prev, uint8_t* out) {
+    size_t size = 0;
+    for (size_t i = 0; i < f.size(); i++) {
+        // differences are computed modulo 2^64 so they can't overflow
+        size += put_varint(out + size, static_cast<int64_t>(static_cast<uint64_t>(f[i]) - prev[i]));
+    }
+    return size;
+}
+
+bool compact_buffer::decode_sample(const block& b, size_t& offset, fields& f) {
+    for (int64_t& field : f) {
+        int64_t difference;
+        if (!get_varint(b.data, b.size, offset, difference)) {
+            return false;
+        }
+        field = static_cast<int64_t>(static_cast<uint64_t>(field) + difference);
+    }
+    return true;
+}
+
+void compact_buffer::push(const sensors::data_point& p) {
+    const fields f = to_fields(p);
+    uint8_t sample[max_sample_size];
+    size_t size = encode_sample(f, m_open.count ? m_last : fields{}, sample);
+    if (m_open.size + size > block_data_size) {
+        const uint32_t first_block_sequence = m_blocks.first_sequence();
+        m_blocks.push(m_open);
+        if (m_blocks.first_sequence() != first_block_sequence) {
+            // the oldest block was overwritten, so its samples aren't kept anymore
+            const std::optional<block> front = m_blocks.front();
+            if (front && static_cast<int32_t>(front->first_sequence - m_oldest_sequence) > 0) {
+                m_oldest_sequence = front->first_sequence;
+            }
+        }
+        m_open = block{.first_sequence = next_sequence()};
+        // header of the empty block has to be written before the data is overwritten, otherwise checksums of both
+        // header slots could be broken and the oldest sequence number lost
+        write_open_header();
+        size = encode_sample(f, fields{}, sample);
+    }
+
+    // header is written after the sample, so it describes either the previous or the new state of open block
+    memcpy(m_open.data + m_open.size, sample, size);
+    fram::write_raw(open_data_addr() + m_open.size, sample, size);
+    m_open.size += size;
+    m_open.count++;
+    m_last = f;
+    write_open_header();
+}
+
+void compact_buffer::remove_before(uint32_t sequence) {
+    if (static_cast<int32_t>(sequence - m_oldest_sequence) <= 0) {
+        return;
+    }
+    if (static_cast<int32_t>(sequence - next_sequence()) > 0) {
+        sequence = next_sequence();
+    }
+    m_oldest_sequence = sequence;
+
+    m_blocks.remove_first(m_blocks.lower_bound([&](const block& b) { return ends_after(b, sequence); }));
+    if (sequence == next_sequence()) {
+        // all samples of open block were removed, its space can be reused
+        m_open = block{.first_sequence = sequence};
+    }
+    write_open_header();
+}
+
+void compact_buffer::clear() {
+    m_blocks.clear();
+    m_open = block{.first_sequence = next_sequence()};
+    m_oldest_sequence = m_open.first_sequence;
+    m_last_fetch.reset();
+    write_open_header();
+}
+
+bool compact_buffer::fetch(uint32_t& sequence, uint32_t end, snapshot& s) {
+    if (!is_kept(sequence)) {
+        sequence = m_oldest_sequence;
+    }
+    if (static_cast<int32_t>(end - next_sequence()) > 0) {
+        end = next_sequence();
+    }
+    if (static_cast<int32_t>(end - sequence) <= 0) {
+        return false;
+    }
+    s.m_begin = sequence;
+    s.m_end = end;
+
+    uint32_t block_sequence = m_last_fetch && m_last_fetch->next_sequence == sequence
+                                  ? m_last_fetch->block_sequence + 1
+                                  : m_blocks.find_first([&](const block& b) { return ends_after(b, sequence); });
+    fram_buffer<block>::snapshot blocks;
+    // blocks with checksum mismatch are skipped
+    while (m_blocks.fetch(block_sequence, block_sequence + 1, blocks)) {
+        bool fetched = false;
+        blocks.for_each([&](uint32_t fetched_sequence, const block& b) {
+            s.m_block = b;
+            m_last_fetch = fetch_position{.block_sequence = fetched_sequence,
+                                          .next_sequence = b.first_sequence + b.count};
+            fetched = true;
+        });
+        if (fetched) {
+            sequence = m_last_fetch->next_sequence;
+            return true;
+        }
+    }
+
+    // remaining samples are in the open block
+    s.m_block = m_open;
+    sequence = end;
+    return true;
+}
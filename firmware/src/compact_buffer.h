@@ -0,0 +1,191 @@
+#ifndef ANTENVSENS_COMPACT_BUFFER_H
+#define ANTENVSENS_COMPACT_BUFFER_H
+#include "fram.h"
+#include "fram_buffer.h"
+#include "sensors.h"
+
+#include <array>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+/*
+compact_buffer stores data points in fram_buffer as blocks of delta encoded
+samples. Every sample is encoded as differences of its timestamp and sensor
+values (as fixed point numbers in millionths) from the previous sample in block,
+the first sample of block is encoded against zeros so every block can be decoded
+on its own. Differences are stored as zigzag varints, so samples of slowly
+changing values take about 10 bytes instead of 48. Decoded values are equal to
+stored ones, so output is the same as for fram_buffer<sensors::data_point>.
+Blocks have constant size and only amount of samples in them varies, so entry
+checksum of fram_buffer protects the whole block and ends of data block are
+restored after startup the same way as for any other fram_buffer.
+Samples are appended to an open block kept in RAM and in a separate area of
+fram. Encoded sample is written past the used part of the area and then one of
+two header slots (written alternately) is updated. Header checksum covers used
+part of the area, so if power is lost at any point at most the sample being
+written is lost. Full open block is pushed into fram_buffer and a new one is
+started. Sequence numbers are assigned to samples and the oldest sample which
+wasn't removed is kept in the open block header, blocks are removed from
+fram_buffer once all of their samples are removed.
+*/
+class compact_buffer {
+    using addr_t = fram::addr_t;
+    using crc_t = uint32_t;
+
+  public:
+    constexpr static size_t block_data_size = 242;
+
+    struct block {
+        // sequence number of the first sample in block
+        uint32_t first_sequence;
+        uint8_t count{};
+        // amount of used bytes of data
+        uint8_t size{};
+        uint8_t data[block_data_size]{};
+    };
+
+  private:
+    // timestamp in milliseconds followed by sensor values in millionths
+    // timestamp followed by values
+    using fields = std::array<int64_t, 1 + sensors::channel_count>;
+    // every field takes at most 10 bytes as varint
+    constexpr static size_t max_sample_size = std::tuple_size_v<fields> * 10;
+
+    struct open_block_header {
+        uint32_t revision;
+        uint32_t first_sequence;
+        uint32_t oldest_sequence;
+        uint16_t count;
+        uint16_t size;
+        crc_t crc{};
+    };
+
+  public:
+    // space of fram used by open block
+    constexpr static addr_t open_block_size = 2 * sizeof(open_block_header) + block_data_size;
+
+  private:
+    addr_t m_open_addr;
+    fram_buffer<block> m_blocks;
+    block m_open{};
+    // fields of the last sample in open block
+    fields m_last{};
+    uint32_t m_open_revision = 0;
+    // samples with lower sequence numbers were removed
+    uint32_t m_oldest_sequence = 0;
+    // position of block copied by the last fetch() invocation, blocks are usually fetched one after another
+    struct fetch_position {
+        // sequence number of block in fram_buffer
+        uint32_t block_sequence;
+        // sequence number of sample following the block
+        uint32_t next_sequence;
+    };
+    std::optional<fetch_position> m_last_fetch;
+
+    addr_t open_data_addr() const { return m_open_addr + 2 * sizeof(open_block_header); }
+    void write_open_header();
+    void remove_before(uint32_t sequence);
+
+    static crc_t open_header_crc(const open_block_header& h, const uint8_t* data);
+    static fields to_fields(const sensors::data_point& p);
+    static sensors::data_point to_data_point(const fields& f);
+    // encodes @f as differences from @prev, returns size of encoded sample
+    static size_t encode_sample(const fields& f, const fields& prev, uint8_t* out);
+    // decodes sample at @offset of @b and moves @offset past it, @f has to contain
+    // the previous sample, returns false if data is malformed
+    static bool decode_sample(const block& b, size_t& offset, fields& f);
+
+    bool is_kept(uint32_t sequence) const { return static_cast<int32_t>(sequence - m_oldest_sequence) >= 0; }
+
+    // invokes func(sequence number, data point) for every sample in @b
+    static void for_each_sample(const block& b, std::invocable<uint32_t, sensors::data_point&> auto&& func) {
+        fields f{};
+        size_t offset = 0;
+        for (uint8_t i = 0; i < b.count && decode_sample(b, offset, f); i++) {
+            sensors::data_point p = to_data_point(f);
+            func(b.first_sequence + i, p);
+        }
+    }
+
+    // returns true if block @b contains samples with sequence numbers not lower than @sequence
+    static bool ends_after(const block& b, uint32_t sequence) {
+        return static_cast<int32_t>(b.first_sequence + b.count - sequence) > 0;
+    }
+
+  public:
+    compact_buffer(addr_t begin, addr_t end, addr_t checkpoint_addr);
+
+    // returns sequence number which will be assigned to next pushed sample
+    uint32_t next_sequence() const { return m_open.first_sequence + m_open.count; }
+
+    void push(const sensors::data_point& p);
+
+    // returns sequence number of the oldest sample
+    uint32_t first_sequence() const { return m_oldest_sequence; }
+
+    // returns sequence number of the first sample for which @pred returns
+    // true or next_sequence() if there is no such sample, @pred has to return
+    // false for all samples preceding it and true for all following ones
+    uint32_t find_first(std::predicate<const sensors::data_point&> auto&& pred) {
+        std::optional<uint32_t> found;
+        auto find_in = [&](uint32_t, const block& b) {
+            for_each_sample(b, [&](uint32_t sequence, sensors::data_point& p) {
+                if (!found && is_kept(sequence) && pred(p)) {
+                    found = sequence;
+                }
+            });
+        };
+        auto last_matches = [&](const block& b) {
+            bool matches = false;
+            for_each_sample(b, [&](uint32_t, sensors::data_point& p) { matches = pred(p); });
+            return matches;
+        };
+        uint32_t block_sequence = m_blocks.find_first(last_matches);
+        fram_buffer<block>::snapshot blocks;
+        if (m_blocks.fetch(block_sequence, block_sequence + 1, blocks)) {
+            blocks.for_each(find_in);
+        }
+        if (!found) {
+            find_in(0, m_open);
+        }
+        return found ? *found : next_sequence();
+    }
+
+    // copy of a block of samples, lets caller decode them without preventing
+    // modifications of buffer in the meantime
+    class snapshot {
+        friend compact_buffer;
+        block m_block;
+        uint32_t m_begin = 0;
+        uint32_t m_end = 0;
+
+      public:
+        // invokes func(sequence number, data point) for every fetched sample
+        void for_each(std::invocable<uint32_t, sensors::data_point&> auto&& func) const {
+            for_each_sample(m_block, [&](uint32_t sequence, sensors::data_point& p) {
+                if (static_cast<int32_t>(sequence - m_begin) >= 0 && static_cast<int32_t>(sequence - m_end) < 0) {
+                    func(sequence, p);
+                }
+            });
+        }
+    };
+
+    // copies block containing sample with sequence number @sequence (or the
+    // oldest one if it was already removed) to @s, samples with sequence
+    // numbers lower than @sequence or not lower than @end are skipped by
+    // snapshot, moves @sequence past copied samples, returns false if there
+    // are no such samples
+    bool fetch(uint32_t& sequence, uint32_t end, snapshot& s);
+
+    // removes samples with sequence numbers up to @sequence (inclusive)
+    void remove_until(uint32_t sequence) { remove_before(sequence + 1); }
+
+    void clear();
+
+    compact_buffer(const compact_buffer&) = delete;
+    compact_buffer& operator=(const compact_buffer&) = delete;
+};
+
+#endif
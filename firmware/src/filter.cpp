@@ -0,0 +1,72 @@
+#include "filter.h"
+
+#include <algorithm>
+
+namespace filter {
+namespace {
+constexpr int64_t fixed_point_factor = 1000000;
+
+int64_t to_fixed_point(const sensor_value& sv) { return sv.val1 * fixed_point_factor + sv.val2; }
+
+sensor_value to_sensor_value(int64_t v) {
+    return {.val1 = static_cast<int32_t>(v / fixed_point_factor), .val2 = static_cast<int32_t>(v % fixed_point_factor)};
+}
+
+int64_t mean(const int64_t* values, size_t count) {
+    int64_t sum = 0;
+    for (size_t i = 0; i < count; i++) {
+        sum += values[i];
+    }
+    // rounded to nearest
+    return (sum + (sum < 0 ? -1 : 1) * static_cast<int64_t>(count / 2)) / static_cast<int64_t>(count);
+}
+
+int64_t median(int64_t* values, size_t count) {
+    int64_t* middle = values + count / 2;
+    std::nth_element(values, middle, values + count);
+    if (count % 2 != 0) {
+        return *middle;
+    }
+    // mean of two middle values, the lower one is the largest value of the lower half
+    const int64_t lower = *std::max_element(values, middle);
+    return lower + (*middle - lower) / 2;
+}
+}
+
+sensors::data_point reducer::reduce(kernel k, uint32_t ema_shift, std::span<const sensors::data_point> samples) {
+    if (k != kernel::ema || ema_shift != m_ema_shift) {
+        m_ema_valid = false;
+    }
+    m_ema_shift = ema_shift;
+
+    sensors::data_point p{.timestamp_ms = samples.front().timestamp_ms};
+    int64_t values[max_samples];
+    const size_t count = std::min(samples.size(), max_samples);
+    for (size_t channel = 0; channel < sensors::channel_count; channel++) {
+        for (size_t i = 0; i < count; i++) {
+            values[i] = to_fixed_point(samples[i].values[channel]);
+        }
+
+        int64_t reduced = 0;
+        switch (k) {
+        case kernel::mean:
+            reduced = mean(values, count);
+            break;
+        case kernel::median:
+            reduced = median(values, count);
+            break;
+        case kernel::ema: {
+            int64_t& state = m_ema[channel];
+            for (size_t i = 0; i < count; i++) {
+                state = m_ema_valid || i != 0 ? state + values[i] - (state >> ema_shift) : values[i] << ema_shift;
+            }
+            reduced = state >> ema_shift;
+            break;
+        }
+        }
+        p.values[channel] = to_sensor_value(reduced);
+    }
+    m_ema_valid = k == kernel::ema;
+    return p;
+}
+}
@@ -0,0 +1,36 @@
+#ifndef ANTENVSENS_FILTER_H
+#define ANTENVSENS_FILTER_H
+#include "sensors.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+/*
+Filters reduce sub-samples taken during a single period into one data point.
+Values are processed as fixed point numbers in millionths. Mean and median use
+only sub-samples of the current period, exponential moving average keeps its
+state between periods and every sub-sample moves it by 1/2^shift of its
+difference from the average.
+*/
+namespace filter {
+enum class kernel : uint32_t { mean, median, ema };
+
+// the most sub-samples that can be taken during a single period
+constexpr size_t max_samples = 16;
+constexpr uint32_t min_ema_shift = 1;
+constexpr uint32_t max_ema_shift = 8;
+
+class reducer {
+    // averages in millionths multiplied by 2^m_ema_shift
+    int64_t m_ema[sensors::channel_count]{};
+    uint32_t m_ema_shift = 0;
+    bool m_ema_valid = false;
+
+  public:
+    // reduces @samples (at least one) with @k, timestamp of the first sub-sample is used
+    sensors::data_point reduce(kernel k, uint32_t ema_shift, std::span<const sensors::data_point> samples);
+};
+}
+
+#endif
@@ -1,5 +1,7 @@
 #include "fram.h"
 
+#include "stats.h"
+
 #include <zephyr/drivers/eeprom.h>
 #include <zephyr/kernel.h>
 #include <zephyr/sys/printk.h>
@@ -22,7 +24,10 @@ void clear() {
 }
 
 void write_raw(addr_t addr, const void* data, size_t size) {
-    if (int rc = eeprom_write(fram, addr, data, size); rc < 0) {
+    const uint32_t start = k_cycle_get_32();
+    const int rc = eeprom_write(fram, addr, data, size);
+    stats::current.fram_writes.add(size, k_cyc_to_us_floor32(k_cycle_get_32() - start), rc < 0);
+    if (rc < 0) {
         while (1) {
             printk("Error: Couldn't write to eeprom, err: %d\n", rc);
             k_sleep(K_MSEC(1000));
@@ -31,7 +36,10 @@ void write_raw(addr_t addr, const void* data, size_t size) {
 }
 
 void read_raw(addr_t addr, void* data, size_t size) {
-    if (int rc = eeprom_read(fram, addr, data, size); rc < 0) {
+    const uint32_t start = k_cycle_get_32();
+    const int rc = eeprom_read(fram, addr, data, size);
+    stats::current.fram_reads.add(size, k_cyc_to_us_floor32(k_cycle_get_32() - start), rc < 0);
+    if (rc < 0) {
         while (1) {
             printk("Error: Couldn't read eeprom, err: %d\n", rc);
             k_sleep(K_MSEC(1000));
@@ -20,11 +20,40 @@ class memory_block {
     constexpr addr_t size() const { return m_size; }
 };
 
+// space reserved for checkpoint slots of a single fram_buffer
+constexpr addr_t buffer_checkpoint_size = 64;
+
 namespace memory_map {
 constexpr memory_block device_name = {0, 256};
+// period rounded up to whole seconds, the only period kept by earlier firmware
 constexpr memory_block period = {device_name.end(), 4};
-constexpr memory_block env_secondary_buffer = {period.end(), 5100};
-constexpr memory_block env_main_buffer = {env_secondary_buffer.end(), fram_size - env_secondary_buffer.end()};
+constexpr memory_block batch_size = {period.end(), 4};
+// deadbands of up to 8 sensor values
+constexpr memory_block deadbands = {batch_size.end(), 32};
+constexpr memory_block heartbeat = {deadbands.end(), 4};
+constexpr memory_block fast_period = {heartbeat.end(), 4};
+// rate thresholds of up to 8 sensor values
+constexpr memory_block rate_thresholds = {fast_period.end(), 32};
+constexpr memory_block oversampling = {rate_thresholds.end(), 4};
+constexpr memory_block filter = {oversampling.end(), 4};
+constexpr memory_block ema_shift = {filter.end(), 4};
+constexpr memory_block period_ms = {ema_shift.end(), 4};
+constexpr memory_block env_main_buffer_checkpoint = {period_ms.end(), buffer_checkpoint_size};
+#ifdef CONFIG_ANTENVSENS_ROLLUPS
+constexpr memory_block env_minute_rollups_checkpoint = {env_main_buffer_checkpoint.end(), buffer_checkpoint_size};
+constexpr memory_block env_hour_rollups_checkpoint = {env_minute_rollups_checkpoint.end(), buffer_checkpoint_size};
+constexpr memory_block env_day_rollups_checkpoint = {env_hour_rollups_checkpoint.end(), buffer_checkpoint_size};
+// about 4 hours of minute records
+constexpr memory_block env_minute_rollups = {env_day_rollups_checkpoint.end(), 20480};
+// about 2 weeks of hour records
+constexpr memory_block env_hour_rollups = {env_minute_rollups.end(), 28672};
+// about a year of day records
+constexpr memory_block env_day_rollups = {env_hour_rollups.end(), 30720};
+constexpr memory_block env_main_buffer = {env_day_rollups.end(), fram_size - env_day_rollups.end()};
+#else
+constexpr memory_block env_main_buffer = {env_main_buffer_checkpoint.end(),
+                                          fram_size - env_main_buffer_checkpoint.end()};
+#endif
 }
 
 void init();
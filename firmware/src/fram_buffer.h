@@ -5,18 +5,35 @@
 #include <zephyr/sys/crc.h>
 #include <zephyr/sys/printk.h>
 
+#include <algorithm>
 #include <concepts>
+#include <cstddef>
 #include <cstdint>
+#include <cstring>
 #include <optional>
 #include <type_traits>
 
 /*
 fram_buffer is a circular buffer stored in fram.
 Size of each entry in buffer is constant and equal to sizeof(T) + size of
-metadata (header and checksum). Each entry starts with header used to find ends
-of data block after startup (this is more robust than keeping positons of ends
-of data block separately in fram as after power loss we will lose at most one
-entry), proceeded by user data and ends with crc32 checksum of user data.
+metadata (header, sequence number and checksum). Each entry starts with header,
+proceeded by sequence number and user data and ends with crc32 checksum of
+preceding fields. Sequence numbers increase by one with every pushed element, so
+entries in data block have consecutive sequence numbers and entries left from
+earlier generations of data have lower ones.
+Positions of ends of data block are saved as a checkpoint every few pushes and
+whenever elements are removed. After startup buffer is restored from the most
+recent valid checkpoint and only entries pushed after it was saved are scanned,
+an entry following the end of data block belongs to it only if it has the next
+sequence number and correct checksum, so after power loss we will lose at most
+one entry. Removing elements (including clearing the whole buffer) only moves
+the beginning of data block in checkpoint, removed entries are left in fram and
+recognized as stale by their sequence numbers. If both checkpoint slots are
+corrupted the whole buffer is scanned and the longest run of consecutive
+sequence numbers ending with the highest one is restored, which may bring back
+removed elements.
+Entries are read in windows of multiple adjacent entries, each window is fetched
+from fram in a single transaction.
 */
 template <typename T>
     requires std::is_trivially_copyable_v<T> // buffer is stored in nonreferenceable address space
@@ -30,30 +47,39 @@ class fram_buffer {
     // range of user data stored in buffer
     addr_t m_data_begin;
     addr_t m_data_end;
+    // sequence number of next pushed element
+    uint32_t m_next_sequence = 0;
+    // location of two checkpoint slots, written alternately
+    addr_t m_checkpoint_addr;
+    uint32_t m_checkpoint_revision = 0;
+    uint8_t m_pushes_since_checkpoint = 0;
 
     struct entry_header {
-        constexpr static auto valid_signature = 0x75;
-        uint8_t signature : 7 = valid_signature;
-        bool peeked : 1 = false;
+        constexpr static uint8_t valid_signature = 0x75;
+        uint8_t signature = valid_signature;
         bool is_valid() const { return signature == valid_signature; }
     };
-    constexpr static auto entry_size = sizeof(entry_header) + sizeof(T) + sizeof(crc_t);
-
-    using it_func = addr_t (fram_buffer::*)(addr_t) const;
-    // finds first entry for which predicate @pred returns true, uses @advance to
-    // iterate through buffer starting from
-    // @start_entry
-    addr_t find_entry(const addr_t start_entry, it_func advance, std::invocable<entry_header> auto&& pred) {
-        const addr_t first_entry = (this->*advance)(start_entry);
-        addr_t next_entry;
-        for (addr_t entry = first_entry; entry != start_entry; entry = next_entry) {
-            if (pred(fram::read<entry_header>(entry))) {
-                return entry;
-            }
-            next_entry = (this->*advance)(entry);
-        }
-        return m_buf_begin;
-    }
+    constexpr static auto sequence_offset = sizeof(entry_header);
+    constexpr static auto elem_offset = sequence_offset + sizeof(uint32_t);
+    constexpr static auto crc_offset = elem_offset + sizeof(T);
+    constexpr static auto entry_size = crc_offset + sizeof(crc_t);
+    // amount of entries fetched from fram in a single read, window is kept on stack so its size is limited
+    constexpr static size_t read_window_entries = std::max<size_t>(512 / entry_size, 1);
+
+    // saved positions of ends of data block, slot with the highest revision and correct crc is the most recent one (if
+    // power was lost while writing it the other slot is still valid)
+    struct checkpoint {
+        uint32_t revision;
+        addr_t data_begin;
+        addr_t data_end;
+        uint32_t next_sequence;
+        crc_t crc{};
+
+        crc_t calc_crc() const { return crc32_ieee(reinterpret_cast<const uint8_t*>(this), offsetof(checkpoint, crc)); }
+    };
+    static_assert(2 * sizeof(checkpoint) <= fram::buffer_checkpoint_size);
+    // amount of entries that may have to be scanned after restoring from checkpoint is bounded by twice this value
+    constexpr static uint8_t checkpoint_interval = 8;
 
     // returns address of next entry, assumes that @entry is valid entry address
     addr_t next_entry(addr_t entry) const {
@@ -74,129 +100,343 @@ class fram_buffer {
         }
     }
 
-    std::optional<T> read_entry(addr_t entry) {
-        const entry_header header = fram::read<entry_header>(entry);
-        const T elem = fram::read<T>(entry + sizeof(entry_header));
-        const crc_t read_crc = fram::read<crc_t>(entry + entry_size - sizeof(crc_t));
-        const crc_t calc_crc = entry_crc(header, elem);
-        if (read_crc == calc_crc) {
-            return elem;
+    // returns amount of entries between @from and @to
+    size_t distance(addr_t from, addr_t to) const {
+        if (to >= from) {
+            return (to - from) / entry_size;
+        }
+        return capacity() - (from - to) / entry_size;
+    }
+
+    // returns address of entry @index entries after the beginning of data block
+    addr_t entry_at(size_t index) const {
+        return m_buf_begin + ((m_data_begin - m_buf_begin) / entry_size + index) % capacity() * entry_size;
+    }
+
+    // parses entry copied from fram to @data, returns element if checksum is correct
+    static std::optional<T> parse_entry(const uint8_t* data, uint32_t& sequence) {
+        entry_header header;
+        crc_t read_crc;
+        memcpy(&header, data, sizeof(header));
+        memcpy(&read_crc, data + crc_offset, sizeof(read_crc));
+        if (!header.is_valid() || read_crc != crc32_ieee(data, crc_offset)) {
+            return {};
         }
-        return {};
+        T elem;
+        memcpy(&sequence, data + sequence_offset, sizeof(sequence));
+        memcpy(&elem, data + elem_offset, sizeof(elem));
+        return elem;
     }
 
-    crc_t entry_crc(entry_header header, const T& elem) {
-        crc_t crc = crc32_ieee(reinterpret_cast<const uint8_t*>(&header), sizeof(header));
-        crc = crc32_ieee_update(crc, reinterpret_cast<const uint8_t*>(&elem), sizeof(elem));
-        return crc;
+    std::optional<T> read_entry(addr_t entry, uint32_t& sequence) {
+        uint8_t data[entry_size];
+        fram::read_raw(entry, data, sizeof(data));
+        return parse_entry(data, sequence);
     }
 
-    void invalidate_entry(addr_t entry) { fram::write(entry, entry_header{.signature = 0}); }
+    // returns amount of entries starting from @entry that can be read in a single window, window can't cross @end nor
+    // the last entry of the buffer
+    size_t window_entries(addr_t entry, addr_t end) const {
+        const addr_t window_end = entry < end ? end : m_buf_begin + capacity() * entry_size;
+        return std::min<size_t>((window_end - entry) / entry_size, read_window_entries);
+    }
+
+    // invokes func for every entry with correct checksum in range [@begin, @end), entries are fetched from fram in
+    // windows of up to read_window_entries adjacent entries, returns amount of entries with checksum mismatch
+    uint16_t read_entries(addr_t begin, addr_t end, std::invocable<uint32_t, T&> auto&& func) {
+        uint16_t invalid_entries = 0;
+        uint8_t window[read_window_entries * entry_size];
+        addr_t entry = begin;
+        while (entry != end) {
+            const size_t count = window_entries(entry, end);
+            fram::read_raw(entry, window, count * entry_size);
+            for (size_t i = 0; i < count; i++) {
+                uint32_t sequence;
+                std::optional<T> elem = parse_entry(window + i * entry_size, sequence);
+                if (elem) {
+                    func(sequence, *elem);
+                } else {
+                    invalid_entries++;
+                }
+                entry = next_entry(entry);
+            }
+        }
+        return invalid_entries;
+    }
+
+    bool is_entry_addr(addr_t addr) const {
+        return addr >= m_buf_begin && addr < m_buf_begin + capacity() * entry_size &&
+               (addr - m_buf_begin) % entry_size == 0;
+    }
+
+    std::optional<checkpoint> read_checkpoint() {
+        checkpoint slots[2];
+        fram::read(m_checkpoint_addr, slots);
+        std::optional<checkpoint> latest;
+        for (const checkpoint& c : slots) {
+            if (c.crc != c.calc_crc() || !is_entry_addr(c.data_begin) || !is_entry_addr(c.data_end)) {
+                continue;
+            }
+            if (!latest || static_cast<int32_t>(c.revision - latest->revision) > 0) {
+                latest = c;
+            }
+        }
+        return latest;
+    }
+
+    void write_checkpoint() {
+        m_checkpoint_revision++;
+        checkpoint c{.revision = m_checkpoint_revision,
+                     .data_begin = m_data_begin,
+                     .data_end = m_data_end,
+                     .next_sequence = m_next_sequence};
+        c.crc = c.calc_crc();
+        fram::write(m_checkpoint_addr + (m_checkpoint_revision % 2) * sizeof(checkpoint), c);
+        m_pushes_since_checkpoint = 0;
+    }
+
+    // returns true if @entry contains element with sequence number @sequence and correct checksum
+    bool has_sequence(addr_t entry, uint32_t sequence) {
+        uint32_t entry_sequence;
+        return read_entry(entry, entry_sequence) && entry_sequence == sequence;
+    }
+
+    // restores ends of data block from checkpoint and moves the end past entries pushed after checkpoint was saved,
+    // returns false if fram content doesn't match the checkpoint
+    bool restore_from_checkpoint(const checkpoint& c) {
+        m_data_begin = c.data_begin;
+        m_data_end = c.data_end;
+        m_next_sequence = c.next_sequence;
+
+        bool begin_overwritten = false;
+        for (uint16_t pushed = 0; has_sequence(m_data_end, m_next_sequence); pushed++) {
+            if (pushed == 2 * checkpoint_interval) {
+                return false;
+            }
+            m_data_end = next_entry(m_data_end);
+            m_next_sequence++;
+            if (m_data_end == m_data_begin) {
+                begin_overwritten = true;
+            }
+        }
+        if (begin_overwritten) {
+            // buffer wrapped, oldest entry follows the one at the end of data block, which is always unused
+            m_data_begin = next_entry(m_data_end);
+        }
+        return true;
+    }
+
+    // restores ends of data block and m_next_sequence by scanning whole buffer, @fallback is used as next sequence
+    // number if there are no valid entries
+    void restore_from_scan(uint32_t fallback) {
+        std::optional<uint32_t> last_sequence;
+        addr_t last_entry = m_buf_begin;
+        addr_t entry = m_buf_begin;
+        do {
+            uint32_t sequence;
+            if (read_entry(entry, sequence) && (!last_sequence || sequence > *last_sequence)) {
+                last_sequence = sequence;
+                last_entry = entry;
+            }
+            entry = next_entry(entry);
+        } while (entry != m_buf_begin);
+
+        if (!last_sequence) {
+            m_data_begin = m_buf_begin;
+            m_data_end = m_buf_begin;
+            m_next_sequence = fallback;
+            return;
+        }
+        m_data_end = next_entry(last_entry);
+        m_next_sequence = *last_sequence + 1;
+        m_data_begin = last_entry;
+        // entry at the end of data block has to stay unused
+        while (prev_entry(m_data_begin) != m_data_end &&
+               has_sequence(prev_entry(m_data_begin), m_next_sequence - size() - 1)) {
+            m_data_begin = prev_entry(m_data_begin);
+        }
+    }
 
   public:
-    fram_buffer(addr_t begin, addr_t end) : m_buf_begin{begin}, m_buf_end{end} {
+    fram_buffer(addr_t begin, addr_t end, addr_t checkpoint_addr)
+        : m_buf_begin{begin}, m_buf_end{end}, m_checkpoint_addr{checkpoint_addr} {
         // restores m_data_begin and m_data_end using data from fram
-        if (fram::read<entry_header>(begin).is_valid()) {
-            m_data_end =
-                find_entry(m_buf_begin, &fram_buffer::next_entry, [](entry_header h) { return !h.is_valid(); });
-            m_data_begin = next_entry(
-                find_entry(m_buf_begin, &fram_buffer::prev_entry, [](entry_header h) { return !h.is_valid(); }));
-        } else {
-            m_data_end = next_entry(
-                find_entry(m_buf_begin, &fram_buffer::prev_entry, [](entry_header h) { return h.is_valid(); }));
-            m_data_begin =
-                find_entry(m_buf_begin, &fram_buffer::next_entry, [](entry_header h) { return h.is_valid(); });
+        const std::optional<checkpoint> c = read_checkpoint();
+        if (c) {
+            m_checkpoint_revision = c->revision;
         }
+        if (!c || !restore_from_checkpoint(*c)) {
+            restore_from_scan(c ? c->next_sequence : 0);
+        }
+        write_checkpoint();
     }
 
     size_t capacity() const { return (m_buf_end - m_buf_begin) / entry_size; }
 
+    // returns amount of entries in data block
+    size_t size() const { return distance(m_data_begin, m_data_end); }
+
+    // returns sequence number which will be assigned to next pushed element
+    uint32_t next_sequence() const { return m_next_sequence; }
+
+    // returns sequence number of the oldest element
+    uint32_t first_sequence() const { return m_next_sequence - size(); }
+
     // adds element to the buffer
     void push(const T& elem) {
         const addr_t next = next_entry(m_data_end);
-        const entry_header next_header = fram::read<entry_header>(next);
-        if (next_header.is_valid()) {
-            // front of buffer reached back of buffer, ends of buffer have to be
-            // separated by an empty entry to properly restore backup from fram
-            // after restart
-            invalidate_entry(next);
+        if (next == m_data_begin) {
+            // front of buffer reached back of buffer, entry at the end of data
+            // block is kept unused so that full and empty buffer can be told apart
             m_data_begin = next_entry(next);
         }
 
+        // whole entry is written in a single transaction, so if power is lost
+        // in between its checksum doesn't match
+        uint8_t buf[entry_size];
         const entry_header header;
-        const crc_t crc = entry_crc(header, elem);
-        fram::write(m_data_end, header);
-        fram::write(m_data_end + sizeof(entry_header), elem);
-        fram::write(m_data_end + entry_size - sizeof(crc), crc);
+        memcpy(buf, &header, sizeof(header));
+        memcpy(buf + sequence_offset, &m_next_sequence, sizeof(m_next_sequence));
+        memcpy(buf + elem_offset, &elem, sizeof(elem));
+        const crc_t crc = crc32_ieee(buf, crc_offset);
+        memcpy(buf + crc_offset, &crc, sizeof(crc));
+        fram::write_raw(m_data_end, buf, sizeof(buf));
 
         m_data_end = next;
+        m_next_sequence++;
+
+        if (++m_pushes_since_checkpoint == checkpoint_interval) {
+            write_checkpoint();
+        }
     }
 
-    // invokes func for every valid element in buffer in chronological order,
-    // returns amount of entries with checksum mismatch
-    uint16_t peek_all(std::invocable<T&> auto&& func) {
-        uint16_t invalid_entries = 0;
-        for (addr_t entry = m_data_begin; entry != m_data_end; entry = next_entry(entry)) {
-            const std::optional<T> elem = read_entry(entry);
-            if (elem) {
-                func(*elem);
-                const entry_header header{.peeked = true};
-                const crc_t crc = entry_crc(header, *elem);
-                fram::write(entry, header);
-                fram::write(entry + entry_size - sizeof(crc), crc);
+    // returns index of the first entry for which @pred returns true using binary search, @pred has to return false
+    // for all entries preceding it and true for all following ones, entries with checksum mismatch are skipped
+    size_t lower_bound(std::predicate<const T&> auto&& pred) {
+        size_t low = 0;
+        size_t high = size();
+        while (low < high) {
+            const size_t mid = low + (high - low) / 2;
+            size_t probe = mid;
+            uint32_t sequence;
+            std::optional<T> elem;
+            while (probe < high && !(elem = read_entry(entry_at(probe), sequence))) {
+                probe++;
+            }
+            if (!elem || pred(*elem)) {
+                high = mid;
             } else {
-                invalid_entries++;
+                low = probe + 1;
             }
         }
+        return low;
+    }
 
-        return invalid_entries;
+    // removes @count oldest entries, entries are left in fram and only the checkpoint is updated
+    void remove_first(size_t count) {
+        if (count == 0) {
+            return;
+        }
+        m_data_begin = entry_at(count);
+        write_checkpoint();
+    }
+
+    // returns the oldest element if its checksum is correct
+    std::optional<T> front() {
+        uint32_t sequence;
+        if (m_data_begin == m_data_end) {
+            return {};
+        }
+        return read_entry(m_data_begin, sequence);
+    }
+
+    // returns the newest element if its checksum is correct
+    std::optional<T> back() {
+        uint32_t sequence;
+        if (m_data_begin == m_data_end) {
+            return {};
+        }
+        return read_entry(prev_entry(m_data_end), sequence);
     }
 
-    // clears entries visited during peek_all() invocation
-    void clear_peeked() {
-        for (addr_t entry = m_data_begin; entry != m_data_end; entry = next_entry(entry)) {
-            const entry_header header = fram::read<entry_header>(entry);
-            if (header.is_valid()) {
-                if (header.peeked) {
-                    invalidate_entry(entry);
+    // invokes func(sequence number, element) for every valid element in buffer
+    // in chronological order, returns amount of entries with checksum mismatch
+    uint16_t peek_all(std::invocable<uint32_t, T&> auto&& func) { return read_entries(m_data_begin, m_data_end, func); }
+
+    // returns sequence number of the first element for which @pred returns true or next_sequence() if there is no
+    // such element, @pred has to return false for all elements preceding it and true for all following ones
+    uint32_t find_first(std::predicate<const T&> auto&& pred) { return first_sequence() + lower_bound(pred); }
+
+    // copy of a window of adjacent entries, lets caller process them without
+    // preventing modifications of buffer in the meantime
+    class snapshot {
+        friend fram_buffer;
+        uint8_t m_window[read_window_entries * entry_size];
+        size_t m_count = 0;
+
+      public:
+        // invokes func(sequence number, element) for every copied element with
+        // correct checksum, returns amount of entries with checksum mismatch
+        uint16_t for_each(std::invocable<uint32_t, T&> auto&& func) const {
+            uint16_t invalid_entries = 0;
+            for (size_t i = 0; i < m_count; i++) {
+                uint32_t sequence;
+                std::optional<T> elem = parse_entry(m_window + i * entry_size, sequence);
+                if (elem) {
+                    func(sequence, *elem);
                 } else {
-                    return;
+                    invalid_entries++;
                 }
             }
-            m_data_begin = next_entry(entry);
+            return invalid_entries;
         }
+    };
+
+    // copies a window of entries with sequence numbers starting from @sequence
+    // (or from the oldest one if it was already removed) and lower than @end
+    // to @s, moves @sequence past copied entries, returns false if there are
+    // no such entries
+    bool fetch(uint32_t& sequence, uint32_t end, snapshot& s) {
+        if (static_cast<int32_t>(sequence - first_sequence()) < 0) {
+            sequence = first_sequence();
+        }
+        if (static_cast<int32_t>(end - m_next_sequence) > 0) {
+            end = m_next_sequence;
+        }
+        if (static_cast<int32_t>(end - sequence) <= 0) {
+            return false;
+        }
+        const addr_t entry = entry_at(sequence - first_sequence());
+        s.m_count = std::min<size_t>(window_entries(entry, m_data_end), end - sequence);
+        fram::read_raw(entry, s.m_window, s.m_count * entry_size);
+        sequence += s.m_count;
+        return true;
+    }
+
+    // removes elements with sequence numbers up to @sequence (inclusive)
+    void remove_until(uint32_t sequence) {
+        const int32_t count = sequence - (m_next_sequence - size()) + 1;
+        remove_first(std::clamp<int32_t>(count, 0, size()));
     }
 
     // invokes func for every valid element in buffer in chronological order and
     // removes elements from buffer, returns amount of entries with checksum
     // mismatch
     uint16_t pop_all(std::invocable<T&> auto&& func) {
-        uint16_t invalid_entries = 0;
-        for (addr_t entry = m_data_begin; entry != m_data_end; entry = next_entry(entry)) {
-            const std::optional<T> elem = read_entry(entry);
-            if (elem) {
-                func(*elem);
-            } else {
-                invalid_entries++;
-            }
-            invalidate_entry(entry);
+        if (m_data_begin == m_data_end) {
+            return 0;
         }
 
-        m_data_end = m_buf_begin;
-        m_data_begin = m_buf_begin;
-
+        const uint16_t invalid_entries =
+            read_entries(m_data_begin, m_data_end, [&](uint32_t, T& elem) { func(elem); });
+        clear();
         return invalid_entries;
     }
 
+    // removes all elements, takes a single checkpoint write
     void clear() {
-        addr_t entry = m_buf_begin;
-        do {
-            invalidate_entry(entry);
-            entry = next_entry(entry);
-        } while (entry != m_buf_begin);
-
-        m_data_begin = m_buf_begin;
-        m_data_end = m_buf_begin;
+        m_data_begin = m_data_end;
+        write_checkpoint();
     }
 
     // default ones create shallow copies
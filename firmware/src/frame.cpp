@@ -0,0 +1,24 @@
+#include "frame.h"
+#include "terminal.h"
+
+#include <zephyr/sys/crc.h>
+
+#include <cstring>
+
+namespace frame {
+size_t encode(const void* payload, uint8_t size, uint8_t* out) {
+    const uint32_t crc = crc32_ieee(static_cast<const uint8_t*>(payload), size);
+    out[0] = sync;
+    out[1] = size;
+    memcpy(out + 2, payload, size);
+    memcpy(out + 2 + size, &crc, sizeof(crc));
+    return size + overhead;
+}
+
+void write(const void* payload, uint8_t size) {
+    uint8_t buf[UINT8_MAX + overhead];
+    terminal::write(buf, encode(payload, size, buf));
+}
+
+void write_end() { write(nullptr, 0); }
+}
@@ -0,0 +1,23 @@
+#ifndef ANTENVSENS_FRAME_H
+#define ANTENVSENS_FRAME_H
+#include <cstddef>
+#include <cstdint>
+
+/*
+Binary frames are written to console uart together with text output (bypassing
+printk newline translation). Each frame consists of sync byte, payload length
+(1 byte), payload and crc32 of payload (4 bytes, little endian). Frame with
+empty payload marks end of transfer.
+*/
+namespace frame {
+constexpr uint8_t sync = 0xae;
+// bytes of frame besides payload: sync byte, payload length and crc32
+constexpr size_t overhead = 2 + sizeof(uint32_t);
+
+// encodes frame with @payload into @out, which has to have room for @size + overhead bytes, returns size of the frame
+size_t encode(const void* payload, uint8_t size, uint8_t* out);
+void write(const void* payload, uint8_t size);
+void write_end();
+}
+
+#endif
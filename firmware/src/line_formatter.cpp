@@ -0,0 +1,124 @@
+#include "line_formatter.h"
+
+#include <array>
+#include <cstring>
+
+namespace {
+constexpr int64_t seconds_per_day = 24 * 60 * 60;
+constexpr int64_t fixed_point_factor = 1000000;
+
+// "00", "01", ..., "99"
+constexpr auto digit_pairs = [] {
+    std::array<char, 200> pairs{};
+    for (int i = 0; i < 100; i++) {
+        pairs[2 * i] = static_cast<char>('0' + i / 10);
+        pairs[2 * i + 1] = static_cast<char>('0' + i % 10);
+    }
+    return pairs;
+}();
+
+// writes digits of @value padded with zeros to @width backwards ending at @end, returns their start
+char* format_digits(char* end, uint32_t value, size_t width) {
+    char* p = end;
+    while (value >= 100) {
+        p -= 2;
+        memcpy(p, &digit_pairs[2 * (value % 100)], 2);
+        value /= 100;
+    }
+    if (value >= 10) {
+        p -= 2;
+        memcpy(p, &digit_pairs[2 * value], 2);
+    } else {
+        *--p = static_cast<char>('0' + value);
+    }
+    while (static_cast<size_t>(end - p) < width) {
+        *--p = '0';
+    }
+    return p;
+}
+}
+
+void line_formatter::put(char ch) {
+    if (fits(1)) {
+        m_buf[m_size++] = ch;
+    }
+}
+
+void line_formatter::put_digits(uint32_t value, size_t width) {
+    char digits[max_unsigned_size];
+    const char* begin = format_digits(digits + sizeof(digits), value, width);
+    const size_t size = digits + sizeof(digits) - begin;
+    if (fits(size)) {
+        memcpy(m_buf + m_size, begin, size);
+        m_size += size;
+    }
+}
+
+void line_formatter::put_unsigned(uint32_t value) { put_digits(value, 1); }
+
+void line_formatter::put_millionths(int64_t value) {
+    if (!fits(max_millionths_size)) {
+        return;
+    }
+    // sign is carried by integer part only, the same way as by data_point::print_value
+    const int32_t integer_part = static_cast<int32_t>(value / fixed_point_factor);
+    const int32_t decimal_part = static_cast<int32_t>(value % fixed_point_factor);
+    if (integer_part < 0) {
+        m_buf[m_size++] = '-';
+    }
+    put_digits(integer_part < 0 ? 0u - static_cast<uint32_t>(integer_part) : integer_part, 1);
+    m_buf[m_size++] = '.';
+    put_digits(decimal_part < 0 ? -decimal_part : decimal_part, 6);
+}
+
+void line_formatter::put_time(time_t timestamp) {
+    if (!fits(max_time_ms_size)) {
+        return;
+    }
+    int64_t day = timestamp / seconds_per_day;
+    int64_t second_of_day = timestamp % seconds_per_day;
+    if (second_of_day < 0) {
+        day--;
+        second_of_day += seconds_per_day;
+    }
+    if (day != m_day) {
+        tm date;
+        gmtime_r(&timestamp, &date);
+        char* end = m_date + sizeof(m_date);
+        char* p = format_digits(end, date.tm_mday, 2);
+        *--p = '-';
+        p = format_digits(p, date.tm_mon + 1, 2);
+        *--p = '-';
+        p = format_digits(p, date.tm_year + 1900, 4);
+        m_date_size = end - p;
+        memmove(m_date, p, m_date_size);
+        m_day = day;
+    }
+    memcpy(m_buf + m_size, m_date, m_date_size);
+    m_size += m_date_size;
+
+    const uint32_t s = static_cast<uint32_t>(second_of_day);
+    char* p = m_buf + m_size;
+    p[0] = 'T';
+    memcpy(p + 1, &digit_pairs[2 * (s / 3600)], 2);
+    p[3] = ':';
+    memcpy(p + 4, &digit_pairs[2 * (s / 60 % 60)], 2);
+    p[6] = ':';
+    memcpy(p + 7, &digit_pairs[2 * (s % 60)], 2);
+    m_size += 9;
+}
+
+void line_formatter::put_time_ms(int64_t timestamp_ms) {
+    put_time(static_cast<time_t>(timestamp_ms / 1000));
+    const int64_t ms = timestamp_ms % 1000;
+    if (ms > 0) {
+        put('.');
+        put_digits(static_cast<uint32_t>(ms), 3);
+    }
+}
+
+void line_formatter::end_line() {
+    // room for line ending is always left
+    m_buf[m_size++] = '\r';
+    m_buf[m_size++] = '\n';
+}
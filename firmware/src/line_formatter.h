@@ -0,0 +1,53 @@
+#ifndef ANTENVSENS_LINE_FORMATTER_H
+#define ANTENVSENS_LINE_FORMATTER_H
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+
+/*
+Renders a line of text output into a single buffer, so that it is written to
+console at once instead of being formatted field by field with printk. Numbers
+are converted two digits at a time with a lookup table and date of the last
+formatted timestamp is kept, so the calendar is computed only when consecutive
+timestamps fall on different days. Output is the same as of printk formats
+used for these fields: "%u", "%d.%06d" of values split the same way as by
+sensors::data_point::print_value and "%04d-%02d-%02dT%02d:%02d:%02d" of
+timestamps after epoch, followed by ".%03d" of milliseconds if they aren't zero.
+Fields which don't fit in max_line_size are left out.
+*/
+class line_formatter {
+  public:
+    constexpr static size_t max_line_size = 384;
+    constexpr static size_t max_unsigned_size = 10;
+    constexpr static size_t max_millionths_size = 18;
+    constexpr static size_t max_time_ms_size = 23;
+
+    const char* data() const { return m_buf; }
+    size_t size() const { return m_size; }
+    // clears the line, date of the last timestamp is kept
+    void clear() { m_size = 0; }
+
+    void put(char ch);
+    void put_unsigned(uint32_t value);
+    // puts value given in millionths with 6 decimal places
+    void put_millionths(int64_t value);
+    void put_time(time_t timestamp);
+    void put_time_ms(int64_t timestamp_ms);
+    // ends line with "\r\n", the same line ending as printk output gets on console
+    void end_line();
+
+  private:
+    bool fits(size_t size) const { return m_size + size <= max_line_size; }
+    // puts @value padded with zeros to @width digits
+    void put_digits(uint32_t value, size_t width);
+
+    char m_buf[max_line_size + 2];
+    size_t m_size = 0;
+    // days since epoch of the cached date
+    int64_t m_day = INT64_MIN;
+    // "YYYY-MM-DD"
+    char m_date[16];
+    size_t m_date_size = 0;
+};
+
+#endif
@@ -1,17 +1,29 @@
+#include "compact_buffer.h"
+#include "filter.h"
 #include "fram.h"
 #include "fram_buffer.h"
+#include "frame.h"
+#include "line_formatter.h"
+#include "rollups.h"
 #include "rtc.h"
 #include "sensors.h"
+#include "staging_ring.h"
+#include "stats.h"
+#include "terminal.h"
 #include "user_config.h"
 
-#include <zephyr/console/console.h>
 #include <zephyr/devicetree.h>
 #include <zephyr/drivers/gpio.h>
 #include <zephyr/sys/printk.h>
 
 #include <algorithm>
+#include <atomic>
 #include <cctype>
+#include <charconv>
 #include <cstdlib>
+#include <cstring>
+#include <optional>
+#include <span>
 #include <string_view>
 
 using namespace std::literals;
@@ -22,8 +34,9 @@ constexpr auto io_stack_size = 4096;
 #define LED0_NODE DT_ALIAS(led0)
 const gpio_dt_spec led = GPIO_DT_SPEC_GET(LED0_NODE, gpios);
 
-constexpr auto logger_priority = 2;
-constexpr auto io_priority = 1;
+// logger preempts io thread, so that printing long exports doesn't delay measurements taken with short periods
+constexpr auto logger_priority = 1;
+constexpr auto io_priority = 2;
 
 static K_THREAD_STACK_DEFINE(logger_stack_area, logger_stack_size);
 static K_THREAD_STACK_DEFINE(io_stack_area, io_stack_size);
@@ -33,46 +46,239 @@ static k_thread io_thread_data;
 
 constexpr std::string_view default_name = "antenvsens";
 constexpr uint32_t default_period = 1;
+constexpr uint32_t default_batch_size = 1;
+constexpr uint32_t default_heartbeat = 600;
+// adaptive sampling switches back to normal period after values change slower than their thresholds for this time
+constexpr int64_t fast_mode_hold_ms = 10 * MSEC_PER_SEC;
+constexpr uint32_t default_ema_shift = 2;
 static user_config* config;
 
 static k_mutex main_buffer_mtx;
-static k_mutex secondary_buffer_mtx;
+// given to make logger schedule next measurement again after changing period or time
 static k_sem logger_sleep_smph;
 
-// Printing data from main buffer, waiting for acknowledge before removal and removing data from main buffer is done
-// concurrently to logging data in another thread. To prevent a situation where the logger thread overwrites the entry
-// that was going to be read (and break chronology as a result) because buffer was full (and buffer's head catched up
-// with read position in "get data"), second smaller buffer is used during "get data" execution. After "get data"
-// finishes data from secondary_buffer is moved to main_buffer and subsequent entries from logger thread are pushed into
-// main_buffer
+// Printing data from main buffer is done concurrently to logging data in another thread. Main buffer is locked only
+// while copying a window of entries (a snapshot) which is printed after unlocking it, so logger can keep pushing data
+// during long exports. Entries are identified by sequence numbers, so if logger overwrites entries which weren't
+// printed yet the export continues from the oldest remaining one without breaking chronology
 using fram_buffer_t = fram_buffer<sensors::data_point>;
-static fram_buffer_t* main_f_buffer = nullptr;
-static fram_buffer_t* secondary_f_buffer = nullptr;
+#ifdef CONFIG_ANTENVSENS_COMPACT_STORAGE
+using main_buffer_t = compact_buffer;
+#else
+using main_buffer_t = fram_buffer_t;
+#endif
+static main_buffer_t* main_f_buffer = nullptr;
+
+// Measurements are collected in RAM and written to fram in batches to keep I2C bus free between them. Logger thread is
+// the only producer, consumers (logger thread flushing a full batch and io thread flushing before reading stored data)
+// hold main_buffer_mtx
+static staging_ring<sensors::data_point, CONFIG_ANTENVSENS_STAGING_SIZE> staging;
+// uptime at which the oldest measurement in staging ring was taken
+static int64_t staging_since = 0;
+
+// Measurements pushed into main buffer by logger can be streamed to console as soon as they are stored. Logger never
+// waits for console, measurements which can't be written immediately (during output of a command or when transmit
+// buffer is full because nobody reads it) are left out of the stream
+enum class stream_mode : uint8_t { off, text, binary };
+static std::atomic<stream_mode> stream_state{stream_mode::off};
+
+// writes measurement to stream as frame with the same payload as "get data binary" frames or as text line
+// "@<sequence>,<timestamp in ms>,<values in millionths separated with commas>"
+static void stream_data_point(uint32_t sequence, const sensors::data_point& p) {
+    const stream_mode mode = stream_state.load(std::memory_order_relaxed);
+    if (mode == stream_mode::off) {
+        return;
+    }
+    // "@", sequence, "," and timestamp, then "," and value of every channel, "\r\n" and null terminator of snprintk
+    constexpr size_t max_line_size = 1 + 10 + 1 + 20 + sensors::channel_count * (1 + 20) + 2 + 1;
+    char buf[std::max(max_line_size, sizeof(sequence) + sizeof(p) + frame::overhead)];
+    size_t size = 0;
+    if (mode == stream_mode::binary) {
+        uint8_t payload[sizeof(sequence) + sizeof(p)];
+        static_assert(sizeof(payload) <= UINT8_MAX && sizeof(payload) + frame::overhead <= sizeof(buf));
+        memcpy(payload, &sequence, sizeof(sequence));
+        memcpy(payload + sizeof(sequence), &p, sizeof(p));
+        size = frame::encode(payload, sizeof(payload), reinterpret_cast<uint8_t*>(buf));
+    } else {
+        size += snprintk(buf, sizeof(buf), "@%u,%lld", sequence, static_cast<long long>(p.timestamp_ms));
+        for (const sensor_value& sv : p.values) {
+            size += snprintk(buf + size, sizeof(buf) - size, ",%lld", sv.val1 * 1000000LL + sv.val2);
+        }
+        size += snprintk(buf + size, sizeof(buf) - size, "\r\n");
+    }
+    if (!terminal::try_write(buf, size)) {
+        stats::increment(stats::current.stream_dropped);
+    }
+}
+
+// moves measurements from staging ring to main buffer, main_buffer_mtx has to be locked. Pushed measurements are
+// streamed only if @stream is set, which is done by logger, so that the stream isn't written by command handlers
+static void flush_staging(bool stream = false) {
+    stats::increment(stats::current.flushes);
+    staging.pop_all([&](const sensors::data_point& p) {
+        // push never removes entries by itself, so the oldest one changes only if it was overwritten
+        const uint32_t first_sequence = main_f_buffer->first_sequence();
+        {
+            const stats::timer timer{stats::current.push};
+            main_f_buffer->push(p);
+        }
+        stats::increment(stats::current.overwritten, main_f_buffer->first_sequence() - first_sequence);
+        if (stream) {
+            stream_data_point(main_f_buffer->next_sequence() - 1, p);
+        }
+    });
+}
+
+// locks main buffer from logger thread, recording how long it waited for it
+static void lock_main_buffer_from_logger() {
+    const stats::timer timer{stats::current.mutex_wait};
+    k_mutex_lock(&main_buffer_mtx, K_FOREVER);
+}
+
+// invokes func(sequence number, element) for elements of @buffer with sequence numbers in range [@begin, @end) without
+// keeping buffers locked while func is invoked, @buffer is either main buffer or one of rollup buffers
+template <typename buffer_type>
+static void export_data(buffer_type& buffer, uint32_t begin, uint32_t end, auto&& func) {
+    typename buffer_type::snapshot s;
+    uint32_t sequence = begin;
+    while (true) {
+        k_mutex_lock(&main_buffer_mtx, K_FOREVER);
+        bool fetched;
+        {
+            const stats::timer timer{stats::current.fetch};
+            fetched = buffer.fetch(sequence, end, s);
+        }
+        k_mutex_unlock(&main_buffer_mtx);
+        if (!fetched) {
+            return;
+        }
+        s.for_each(func);
+    }
+}
+
+// returns change of value of @channel between @from and @to in millionths
+static int64_t change(const sensors::data_point& from, const sensors::data_point& to, size_t channel) {
+    const auto fixed_point = [](const sensor_value& sv) { return sv.val1 * 1000000LL + sv.val2; };
+    return fixed_point(to.values[channel]) - fixed_point(from.values[channel]);
+}
+
+// Measurement is stored only if any of its values differs from the last stored one by at least its deadband, or if
+// heartbeat (the longest time without storing anything) elapsed since the last stored one. Stored measurements mark
+// changes, so values between them are the values of the preceding stored measurement (within deadbands), and gaps
+// longer than heartbeat mean that no measurements were taken. With zero deadbands every measurement is stored
+static bool should_store(const sensors::data_point& p) {
+    static std::optional<sensors::data_point> last_stored;
+    const int64_t heartbeat_ms = static_cast<int64_t>(config->get_heartbeat()) * MSEC_PER_SEC;
+    bool store = !last_stored || p.timestamp_ms < last_stored->timestamp_ms ||
+                 p.timestamp_ms - last_stored->timestamp_ms >= heartbeat_ms;
+    for (size_t i = 0; i < sensors::channel_count && !store; i++) {
+        store = llabs(change(*last_stored, p, i)) >= config->get_deadband(i);
+    }
+    if (store) {
+        last_stored = p;
+    }
+    return store;
+}
+
+// returns true if any value changed since the previous measurement faster than its rate threshold
+static bool exceeds_rate_thresholds(const sensors::data_point& p) {
+    static std::optional<sensors::data_point> previous;
+    bool exceeds = false;
+    if (previous && p.timestamp_ms > previous->timestamp_ms) {
+        const int64_t elapsed_ms = p.timestamp_ms - previous->timestamp_ms;
+        for (size_t i = 0; i < sensors::channel_count && !exceeds; i++) {
+            const int64_t threshold = config->get_rate_threshold(i);
+            exceeds = threshold != 0 && llabs(change(*previous, p, i)) * MSEC_PER_SEC >= threshold * elapsed_ms;
+        }
+    }
+    previous = p;
+    return exceeds;
+}
+
+// takes sub-samples one after another and reduces them into a single measurement with selected filter
+static sensors::data_point acquire() {
+    static filter::reducer reducer;
+    sensors::data_point samples[filter::max_samples];
+    const size_t count = config->get_oversampling();
+    for (size_t i = 0; i < count; i++) {
+        samples[i] = sensors::get_data();
+    }
+    return reducer.reduce(config->get_filter(), config->get_ema_shift(), std::span{samples, count});
+}
 
 void logger(void* arg1, void* arg2, void* arg3) {
     ARG_UNUSED(arg1);
     ARG_UNUSED(arg2);
     ARG_UNUSED(arg3);
 
+    // Measurements are scheduled at rtc times which are multiples of period, so that they don't drift regardless of
+    // time it takes to perform them and data from multiple devices has the same timestamps. Time remaining to deadline
+    // is computed from rtc before every sleep, so differences between rtc and kernel clock don't accumulate. The
+    // first measurement after (re)scheduling is taken immediately. In adaptive mode fast period is used while values
+    // change faster than their thresholds
+    int64_t deadline = 0;
+    // period with which deadline was scheduled
+    int64_t period_ms = 0;
+    // fast period is used until this time
+    int64_t fast_until = 0;
     while (1) {
-        gpio_pin_set_dt(&led, 1);
+        const int64_t now = rtc::get_current_time_ms();
+        if (deadline != 0 && now < deadline) {
+            if (k_sem_take(&logger_sleep_smph, K_MSEC(deadline - now)) == 0) {
+                deadline = 0;
+            }
+            continue;
+        }
+        if (deadline != 0 && now - deadline >= period_ms) {
+            const int64_t missed = (now - deadline) / period_ms;
+            stats::increment(stats::current.missed_deadlines, missed);
+            deadline += missed * period_ms;
+        }
+        if (deadline != 0) {
+            // lateness is below the period, which can be long enough to overflow microseconds
+            stats::current.lateness.add(std::min<int64_t>((now - deadline) * USEC_PER_MSEC, UINT32_MAX));
+        }
 
-        k_mutex_lock(&secondary_buffer_mtx, K_FOREVER);
+        gpio_pin_set_dt(&led, 1);
 
-        const sensors::data_point p = sensors::get_data();
-        if (k_mutex_lock(&main_buffer_mtx, K_NO_WAIT) == 0) {
-            secondary_f_buffer->pop_all([&](const sensors::data_point& p) { main_f_buffer->push(p); });
-            main_f_buffer->push(p);
+        // measurements are timestamped with their deadlines, so timestamps from devices with synchronized clocks match
+        sensors::data_point p = acquire();
+        p.timestamp_ms = deadline == 0 ? now : deadline;
+        if (exceeds_rate_thresholds(p)) {
+            fast_until = now + fast_mode_hold_ms;
+        }
+        if (should_store(p)) {
+            if (staging.size() == 0) {
+                staging_since = k_uptime_get();
+            }
+            if (!staging.push(p)) {
+                stats::increment(stats::current.staging_dropped);
+            }
+        }
+#ifdef CONFIG_ANTENVSENS_ROLLUPS
+        lock_main_buffer_from_logger();
+        rollups::add(p);
+        k_mutex_unlock(&main_buffer_mtx);
+#endif
+
+        const bool flush = staging.size() >= config->get_batch_size() ||
+                           k_uptime_get() - staging_since >= CONFIG_ANTENVSENS_FLUSH_INTERVAL * MSEC_PER_SEC;
+        if (staging.size() != 0 && flush) {
+            lock_main_buffer_from_logger();
+            flush_staging(true);
             k_mutex_unlock(&main_buffer_mtx);
-        } else {
-            // use secondary buffer when data in main buffer is in read-acknowledge-remove phase
-            secondary_f_buffer->push(p);
         }
 
-        k_mutex_unlock(&secondary_buffer_mtx);
-
         gpio_pin_set_dt(&led, 0);
-        k_sem_take(&logger_sleep_smph, K_SECONDS(config->get_period()));
+        const uint32_t fast_period_ms = config->get_fast_period_ms();
+        const bool fast = fast_period_ms != 0 && now < fast_until;
+        const int64_t next_period_ms = fast ? fast_period_ms : config->get_period_ms();
+        if (deadline == 0 || next_period_ms != period_ms) {
+            period_ms = next_period_ms;
+            deadline = (now / period_ms + 1) * period_ms;
+        } else {
+            deadline += period_ms;
+        }
     }
 }
 
@@ -86,53 +292,328 @@ struct command {
 
 static void print_help();
 
+// writes binary frame used by "get data" commands, its payload is sequence number followed by data point or rollup
+// record
+template <typename T>
+static void write_data_frame(uint32_t sequence, const T& elem) {
+    uint8_t payload[sizeof(sequence) + sizeof(elem)];
+    // size of frame payload is sent in a single byte
+    static_assert(sizeof(payload) <= UINT8_MAX);
+    memcpy(payload, &sequence, sizeof(sequence));
+    memcpy(payload + sizeof(sequence), &elem, sizeof(elem));
+    frame::write(payload, sizeof(payload));
+}
+
+static bool parse_number(std::string_view s, uint32_t& number) {
+    const auto [end, ec] = std::from_chars(s.data(), s.data() + s.size(), number);
+    return ec == std::errc{} && end == s.data() + s.size();
+}
+
+// parses non-negative decimal number with up to @digits fractional digits as an integer multiple of 10^-@digits
+static bool parse_decimal(std::string_view s, size_t digits, int64_t& value) {
+    constexpr int64_t max_integer_part = INT32_MAX;
+    const size_t dot = s.find('.');
+    const std::string_view fraction = dot == std::string_view::npos ? ""sv : s.substr(dot + 1);
+    const std::string_view integer = s.substr(0, dot);
+    int64_t integer_part = 0;
+    if (!integer.empty()) {
+        const auto [end, ec] = std::from_chars(integer.data(), integer.data() + integer.size(), integer_part);
+        if (ec != std::errc{} || end != integer.data() + integer.size() || integer_part < 0 ||
+            integer_part > max_integer_part) {
+            return false;
+        }
+    }
+    if ((integer.empty() && fraction.empty()) || fraction.size() > digits ||
+        !std::all_of(fraction.begin(), fraction.end(), [](char ch) { return std::isdigit(ch); })) {
+        return false;
+    }
+    value = integer_part;
+    for (size_t i = 0; i < digits; i++) {
+        value = value * 10 + (i < fraction.size() ? fraction[i] - '0' : 0);
+    }
+    return true;
+}
+
+// parses time in seconds with up to 3 fractional digits as milliseconds
+static bool parse_milliseconds(std::string_view s, uint32_t& milliseconds) {
+    int64_t value;
+    if (!parse_decimal(s, 3, value) || value > UINT32_MAX) {
+        return false;
+    }
+    milliseconds = value;
+    return true;
+}
+
+// prints milliseconds as seconds, fractional part is printed only if there is one
+static void print_milliseconds(uint32_t milliseconds) {
+    printk("%u", milliseconds / MSEC_PER_SEC);
+    if (milliseconds % MSEC_PER_SEC != 0) {
+        printk(".%03u", milliseconds % MSEC_PER_SEC);
+    }
+}
+
+// parses "<channel> <value>" parameters of per channel settings, value is parsed as millionths, prints error message
+// if parameters are invalid
+static bool parse_channel_setting(std::string_view params, size_t& channel, int32_t& value) {
+    const size_t separator = params.find(' ');
+    const std::string_view name = params.substr(0, separator);
+    const auto it = std::find_if(std::begin(sensors::channels), std::end(sensors::channels), [&](const auto& c) {
+        return c.name == name;
+    });
+    if (it == std::end(sensors::channels)) {
+        printk("invalid channel\n");
+        return false;
+    }
+    int64_t parsed;
+    if (separator == std::string_view::npos || !parse_decimal(params.substr(separator + 1), 6, parsed) ||
+        parsed > INT32_MAX) {
+        printk("invalid value\n");
+        return false;
+    }
+    channel = it - std::begin(sensors::channels);
+    value = parsed;
+    return true;
+}
+
+// prints value given in millionths the same way as values of data points
+static void print_millionths(int64_t value) {
+    sensors::data_point{}.print_value(
+        {.val1 = static_cast<int32_t>(value / 1000000), .val2 = static_cast<int32_t>(value % 1000000)});
+}
+
+// prints values of per channel setting in millionths
+static void print_channel_settings(auto&& get) {
+    for (size_t i = 0; i < sensors::channel_count; i++) {
+        printk("%s: ", sensors::channels[i].name.data());
+        print_millionths(get(i));
+        printk("\n");
+    }
+}
+
 static void factory_reset_dialog() {
     printk("set new name (default = \"%s\"): ", default_name.data());
-    std::string_view name = console_getline();
+    std::string_view name = terminal::getline();
     if (name.empty()) {
         config->set_name(default_name);
     } else {
         config->set_name(name);
     }
     printk("set new period (default = %d): ", default_period);
-    std::string_view period = console_getline();
-    if (period.empty()) {
-        config->set_period(default_period);
+    std::string_view period = terminal::getline();
+    uint32_t period_ms;
+    if (period.empty() || !parse_milliseconds(period, period_ms)) {
+        config->set_period_ms(default_period * MSEC_PER_SEC);
     } else {
-        config->set_period(atoi(period.data()));
+        config->set_period_ms(period_ms);
+    }
+    config->set_batch_size(default_batch_size);
+    for (size_t i = 0; i < sensors::channel_count; i++) {
+        config->set_deadband(i, 0);
+    }
+    config->set_heartbeat(default_heartbeat);
+    config->set_fast_period_ms(0);
+    config->set_oversampling(1);
+    config->set_filter(filter::kernel::mean);
+    config->set_ema_shift(default_ema_shift);
+    for (size_t i = 0; i < sensors::channel_count; i++) {
+        config->set_rate_threshold(i, 0);
     }
 }
 
 static const command commands[] = {
-    {.name = "get data"sv,
-     .description = "- prints stored data"sv,
+    {.name = "get data since"sv,
+     .description = "<sequence|time> [minute|hour|day] [binary] - prints stored data starting from given sequence "
+                    "number or time, prepended with sequence numbers, minute, hour or day selects summaries of "
+                    "measurements"sv,
+     .handler =
+         [](std::string_view params) {
+             const size_t separator = params.find(' ');
+             const std::string_view start = params.substr(0, separator);
+             std::string_view options = separator == std::string_view::npos ? ""sv : params.substr(separator + 1);
+             bool binary = false;
+             std::optional<rollups::tier> tier;
+             while (!options.empty()) {
+                 const std::string_view option = options.substr(0, options.find(' '));
+                 options.remove_prefix(std::min(option.size() + 1, options.size()));
+                 if (option == "binary"sv) {
+                     binary = true;
+                 } else if (option == "minute"sv) {
+                     tier = rollups::tier::minute;
+                 } else if (option == "hour"sv) {
+                     tier = rollups::tier::hour;
+                 } else if (option == "day"sv) {
+                     tier = rollups::tier::day;
+                 } else {
+                     printk("invalid option\n");
+                     return;
+                 }
+             }
+             uint32_t start_sequence = 0;
+             time_t start_time = 0;
+             const bool by_sequence = parse_number(start, start_sequence);
+             if (!by_sequence && rtc::parse_time(start.data(), &start_time) != 0) {
+                 printk("invalid sequence number or time\n");
+                 return;
+             }
+
+             line_formatter line;
+             if (tier) {
+#ifdef CONFIG_ANTENVSENS_ROLLUPS
+                 rollups::buffer_t& buffer = rollups::buffer(*tier);
+                 k_mutex_lock(&main_buffer_mtx, K_FOREVER);
+                 if (!by_sequence) {
+                     start_sequence =
+                         buffer.find_first([&](const rollups::record& r) { return r.timestamp >= start_time; });
+                 }
+                 const uint32_t end_sequence = buffer.next_sequence();
+                 k_mutex_unlock(&main_buffer_mtx);
+                 export_data(buffer, start_sequence, end_sequence, [&](uint32_t sequence, const rollups::record& r) {
+                     if (binary) {
+                         write_data_frame(sequence, r);
+                     } else {
+                         line.put_unsigned(sequence);
+                         line.put(',');
+                         r.print(line);
+                     }
+                 });
+#else
+                 printk("summaries are disabled\n");
+                 return;
+#endif
+             } else {
+                 k_mutex_lock(&main_buffer_mtx, K_FOREVER);
+                 flush_staging();
+                 if (!by_sequence) {
+                     start_sequence = main_f_buffer->find_first(
+                         [&](const sensors::data_point& p) { return p.timestamp_ms >= start_time * MSEC_PER_SEC; });
+                 }
+                 const uint32_t end_sequence = main_f_buffer->next_sequence();
+                 k_mutex_unlock(&main_buffer_mtx);
+                 auto print = [&](uint32_t sequence, const sensors::data_point& p) {
+                     if (binary) {
+                         write_data_frame(sequence, p);
+                     } else {
+                         line.put_unsigned(sequence);
+                         line.put(',');
+                         p.print(line);
+                     }
+                 };
+                 export_data(*main_f_buffer, start_sequence, end_sequence, print);
+             }
+             if (binary) {
+                 frame::write_end();
+             } else {
+                 printk("end of data\n");
+             }
+         }},
+    {.name = "get summary"sv,
+     .description = "<from> <to> - prints amount of measurements taken from <from> until before <to> and min, max "
+                    "and mean of every value, without printing the measurements"sv,
      .handler =
          [](std::string_view params) {
+             const size_t separator = params.find(' ');
+             time_t from;
+             time_t to;
+             // parsing of time stops at the separator
+             if (separator == std::string_view::npos || rtc::parse_time(params.data(), &from) != 0 ||
+                 rtc::parse_time(params.data() + separator + 1, &to) != 0) {
+                 printk("invalid time\n");
+                 return;
+             }
+
+             // measurements are stored in order of their timestamps, so bounds of the range are found by binary search
+             // and only entries inside it are read
              k_mutex_lock(&main_buffer_mtx, K_FOREVER);
-             time_t last_timestamp = 0;
-             main_f_buffer->peek_all([&](const sensors::data_point& p) {
-                 p.print();
-                 last_timestamp = p.timestamp;
+             flush_staging();
+             const uint32_t begin = main_f_buffer->find_first(
+                 [&](const sensors::data_point& p) { return p.timestamp_ms >= from * MSEC_PER_SEC; });
+             const uint32_t end = main_f_buffer->find_first(
+                 [&](const sensors::data_point& p) { return p.timestamp_ms >= to * MSEC_PER_SEC; });
+             k_mutex_unlock(&main_buffer_mtx);
+
+             uint32_t count = 0;
+             int64_t min[sensors::channel_count];
+             int64_t max[sensors::channel_count];
+             int64_t sum[sensors::channel_count]{};
+             export_data(*main_f_buffer, begin, end, [&](uint32_t, const sensors::data_point& p) {
+                 for (size_t i = 0; i < sensors::channel_count; i++) {
+                     const sensor_value& sv = p.values[i];
+                     const int64_t value = sv.val1 * 1000000LL + sv.val2;
+                     min[i] = count == 0 ? value : std::min(min[i], value);
+                     max[i] = count == 0 ? value : std::max(max[i], value);
+                     sum[i] += value;
+                 }
+                 count++;
              });
+
+             printk("count: %u\n", count);
+             for (size_t i = 0; i < sensors::channel_count && count != 0; i++) {
+                 printk("%s: min=", sensors::channels[i].name.data());
+                 print_millionths(min[i]);
+                 printk(" max=");
+                 print_millionths(max[i]);
+                 printk(" mean=");
+                 // rounded to nearest
+                 print_millionths((sum[i] + (sum[i] < 0 ? -1 : 1) * static_cast<int64_t>(count / 2)) / count);
+                 printk("\n");
+             }
+         }},
+    {.name = "get data"sv,
+     .description = "[binary] - prints stored data, as crc protected binary frames if binary is given"sv,
+     .handler =
+         [](std::string_view params) {
+             const bool binary = params == "binary"sv;
+             k_mutex_lock(&main_buffer_mtx, K_FOREVER);
+             flush_staging();
+             const uint32_t begin_sequence = main_f_buffer->first_sequence();
+             const uint32_t end_sequence = main_f_buffer->next_sequence();
              k_mutex_unlock(&main_buffer_mtx);
+             line_formatter line;
+             auto print = [&](uint32_t sequence, const sensors::data_point& p) {
+                 if (binary) {
+                     write_data_frame(sequence, p);
+                 } else {
+                     p.print(line);
+                 }
+             };
+             export_data(*main_f_buffer, begin_sequence, end_sequence, print);
+             if (binary) {
+                 frame::write_end();
+             }
              printk("remove printed data from the device? (y/N): ");
-             std::string_view s = console_getline();
+             std::string_view s = terminal::getline();
              if (s == "y"sv) {
+                 // data pushed during printing is kept
                  k_mutex_lock(&main_buffer_mtx, K_FOREVER);
-                 main_f_buffer->clear_peeked();
+                 main_f_buffer->remove_until(end_sequence - 1);
                  k_mutex_unlock(&main_buffer_mtx);
              }
          }},
+    {.name = "ack"sv,
+     .description = "<sequence> - removes stored data up to given sequence number"sv,
+     .handler =
+         [](std::string_view params) {
+             uint32_t sequence;
+             if (!parse_number(params, sequence)) {
+                 printk("invalid sequence number\n");
+                 return;
+             }
+             k_mutex_lock(&main_buffer_mtx, K_FOREVER);
+             main_f_buffer->remove_until(sequence);
+             k_mutex_unlock(&main_buffer_mtx);
+             printk("acknowledged\n");
+         }},
     {.name = "clear data"sv,
      .description = "- clears stored data"sv,
      .handler =
          [](std::string_view params) {
              k_mutex_lock(&main_buffer_mtx, K_FOREVER);
-             k_mutex_lock(&secondary_buffer_mtx, K_FOREVER);
              main_f_buffer->clear();
-             secondary_f_buffer->clear();
+             staging.clear();
+#ifdef CONFIG_ANTENVSENS_ROLLUPS
+             rollups::clear();
+#endif
              k_mutex_unlock(&main_buffer_mtx);
-             k_mutex_unlock(&secondary_buffer_mtx);
              printk("data cleared\n");
          }},
     {.name = "set time"sv,
@@ -142,6 +623,7 @@ static const command commands[] = {
              if (rtc::set_current_time(params.data()) == -EINVAL) {
                  printk("invalid time\n");
              } else {
+                 k_sem_give(&logger_sleep_smph);
                  printk("time set\n");
              }
          }},
@@ -153,16 +635,190 @@ static const command commands[] = {
              printk("\n");
          }},
     {.name = "set period"sv,
-     .description = "<period> - sets period"sv,
+     .description = "<period> - sets period in seconds, with up to 3 fractional digits"sv,
      .handler =
          [](std::string_view params) {
-             config->set_period(atoi(params.data()));
+             uint32_t period_ms;
+             if (!parse_milliseconds(params, period_ms)) {
+                 printk("invalid period\n");
+                 return;
+             }
+             config->set_period_ms(period_ms);
              k_sem_give(&logger_sleep_smph);
              printk("period set\n");
          }},
     {.name = "get period"sv,
      .description = "- prints period"sv,
-     .handler = [](std::string_view params) { printk("%u\n", config->get_period()); }},
+     .handler =
+         [](std::string_view params) {
+             print_milliseconds(config->get_period_ms());
+             printk("\n");
+         }},
+    {.name = "set fast period"sv,
+     .description = "<period> - sets period used while values change faster than their thresholds, 0 disables "
+                    "adaptive sampling"sv,
+     .handler =
+         [](std::string_view params) {
+             uint32_t period_ms;
+             if (!parse_milliseconds(params, period_ms)) {
+                 printk("invalid period\n");
+                 return;
+             }
+             config->set_fast_period_ms(period_ms);
+             k_sem_give(&logger_sleep_smph);
+             printk("fast period set\n");
+         }},
+    {.name = "get fast period"sv,
+     .description = "- prints period used while values change faster than their thresholds"sv,
+     .handler =
+         [](std::string_view params) {
+             print_milliseconds(config->get_fast_period_ms());
+             printk("\n");
+         }},
+    {.name = "set threshold"sv,
+     .description = "<channel> <value> - sets change of value per second which switches to fast period, 0 disables "
+                    "the channel"sv,
+     .handler =
+         [](std::string_view params) {
+             size_t channel;
+             int32_t threshold;
+             if (parse_channel_setting(params, channel, threshold)) {
+                 config->set_rate_threshold(channel, threshold);
+                 printk("threshold set\n");
+             }
+         }},
+    {.name = "get threshold"sv,
+     .description = "- prints changes of values per second which switch to fast period"sv,
+     .handler =
+         [](std::string_view params) {
+             print_channel_settings([](size_t channel) { return config->get_rate_threshold(channel); });
+         }},
+    {.name = "set batch"sv,
+     .description = "<size> - sets amount of measurements collected before writing them to fram"sv,
+     .handler =
+         [](std::string_view params) {
+             uint32_t batch_size;
+             if (!parse_number(params, batch_size) || batch_size < user_config::min_batch_size ||
+                 batch_size > user_config::max_batch_size) {
+                 printk("invalid batch\n");
+                 return;
+             }
+             config->set_batch_size(batch_size);
+             printk("batch set\n");
+         }},
+    {.name = "get batch"sv,
+     .description = "- prints amount of measurements collected before writing them to fram"sv,
+     .handler = [](std::string_view params) { printk("%u\n", config->get_batch_size()); }},
+    {.name = "set deadband"sv,
+     .description = "<channel> <value> - measurements are stored only if value of any channel changes by at least its "
+                    "deadband"sv,
+     .handler =
+         [](std::string_view params) {
+             size_t channel;
+             int32_t deadband;
+             if (parse_channel_setting(params, channel, deadband)) {
+                 config->set_deadband(channel, deadband);
+                 printk("deadband set\n");
+             }
+         }},
+    {.name = "get deadband"sv,
+     .description = "- prints deadbands of all channels"sv,
+     .handler =
+         [](std::string_view params) {
+             print_channel_settings([](size_t channel) { return config->get_deadband(channel); });
+         }},
+    {.name = "set heartbeat"sv,
+     .description = "<seconds> - sets the longest time for which no measurements are stored due to deadbands"sv,
+     .handler =
+         [](std::string_view params) {
+             uint32_t heartbeat;
+             if (!parse_number(params, heartbeat) || heartbeat < user_config::min_heartbeat) {
+                 printk("invalid heartbeat\n");
+                 return;
+             }
+             config->set_heartbeat(heartbeat);
+             printk("heartbeat set\n");
+         }},
+    {.name = "get heartbeat"sv,
+     .description = "- prints the longest time for which no measurements are stored due to deadbands"sv,
+     .handler = [](std::string_view params) { printk("%u\n", config->get_heartbeat()); }},
+    {.name = "set oversampling"sv,
+     .description = "<count> - sets amount of sub-samples reduced into every stored measurement"sv,
+     .handler =
+         [](std::string_view params) {
+             uint32_t oversampling;
+             if (!parse_number(params, oversampling) || oversampling < 1 || oversampling > filter::max_samples) {
+                 printk("invalid oversampling\n");
+                 return;
+             }
+             config->set_oversampling(oversampling);
+             printk("oversampling set\n");
+         }},
+    {.name = "get oversampling"sv,
+     .description = "- prints amount of sub-samples reduced into every stored measurement"sv,
+     .handler = [](std::string_view params) { printk("%u\n", config->get_oversampling()); }},
+    {.name = "set filter"sv,
+     .description = "<mean|median|ema> [shift] - sets filter reducing sub-samples, every sub-sample moves exponential "
+                    "moving average by 1/2^shift of its difference from it"sv,
+     .handler =
+         [](std::string_view params) {
+             const size_t separator = params.find(' ');
+             const std::string_view name = params.substr(0, separator);
+             if (name == "mean"sv && separator == std::string_view::npos) {
+                 config->set_filter(filter::kernel::mean);
+             } else if (name == "median"sv && separator == std::string_view::npos) {
+                 config->set_filter(filter::kernel::median);
+             } else if (name == "ema"sv) {
+                 uint32_t shift = 0;
+                 if (separator != std::string_view::npos &&
+                     (!parse_number(params.substr(separator + 1), shift) || shift < filter::min_ema_shift ||
+                      shift > filter::max_ema_shift)) {
+                     printk("invalid shift\n");
+                     return;
+                 }
+                 config->set_filter(filter::kernel::ema);
+                 if (separator != std::string_view::npos) {
+                     config->set_ema_shift(shift);
+                 }
+             } else {
+                 printk("invalid filter\n");
+                 return;
+             }
+             printk("filter set\n");
+         }},
+    {.name = "get filter"sv,
+     .description = "- prints filter reducing sub-samples"sv,
+     .handler =
+         [](std::string_view params) {
+             switch (config->get_filter()) {
+             case filter::kernel::mean:
+                 printk("mean\n");
+                 break;
+             case filter::kernel::median:
+                 printk("median\n");
+                 break;
+             case filter::kernel::ema:
+                 printk("ema %u\n", config->get_ema_shift());
+                 break;
+             }
+         }},
+    {.name = "set baud"sv,
+     .description = "<rate> - switches baud rate of console, the new rate is kept only if \"ping\" line is "
+                    "received with it within 3 s, and until nothing is received for a minute"sv,
+     .handler =
+         [](std::string_view params) {
+             uint32_t baudrate;
+             if (!parse_number(params, baudrate) || !terminal::is_supported_baudrate(baudrate)) {
+                 printk("invalid baud rate\n");
+                 return;
+             }
+             printk("switching baud\n");
+             if (terminal::switch_baudrate(baudrate)) {
+                 printk("pong\n");
+             } else {
+                 printk("baud not changed\n");
+             }
+         }},
     {.name = "set name"sv,
      .description = "<name> - sets name"sv,
      .handler =
@@ -177,40 +833,74 @@ static const command commands[] = {
      .description = "- prints device status"sv,
      .handler =
          [](std::string_view params) {
-             printk("name: %s\n"
-                    "period: %d\n",
-                    config->get_name().data(),
-                    config->get_period());
+             printk("name: %s\n", config->get_name().data());
+             printk("period: ");
+             print_milliseconds(config->get_period_ms());
+             printk("\n");
+             // measurements kept in RAM are lost on power loss
+             printk("batch: %u (up to %u measurements from last %d s may be lost on power loss)\n",
+                    config->get_batch_size(),
+                    config->get_batch_size() - 1,
+                    CONFIG_ANTENVSENS_FLUSH_INTERVAL);
+             printk("missed deadlines: %u\n", stats::missed_deadlines_since_boot());
              printk("time: ");
              rtc::print_time(rtc::get_current_time());
 
-             sensors::data_point p = sensors::get_data();
-             auto print_sensor_value = [&](std::string_view name, sensor_value val) {
-                 printk("  %s: ", name.data());
-                 p.print_value(val);
-                 printk("\n");
-             };
-             printk("\nsht45:\n");
-             print_sensor_value("temperature"sv, p.sht_temperature);
-             print_sensor_value("humidity"sv, p.sht_humidity);
-             printk("bme280:\n");
-             print_sensor_value("temperature"sv, p.bme_temperature);
-             print_sensor_value("humidity"sv, p.bme_humidity);
-             print_sensor_value("pressure"sv, p.bme_pressure);
+             printk("\n");
+             sensors::print_status(sensors::get_data());
+         }},
+    {.name = "get schema"sv,
+     .description = "- prints names of values of entries, in the order of data columns"sv,
+     .handler = [](std::string_view params) { sensors::print_schema(); }},
+    {.name = "get stats"sv,
+     .description = "[reset] - prints runtime statistics, with reset clears them after printing"sv,
+     .handler =
+         [](std::string_view params) {
+             if (!params.empty() && params != "reset"sv) {
+                 printk("invalid option\n");
+                 return;
+             }
+             stats::print();
+             if (params == "reset"sv) {
+                 stats::reset();
+             }
+             printk("end of stats\n");
+         }},
+    {.name = "stream"sv,
+     .description = "<on [binary]|off> - streams measurements as soon as they are stored, as lines starting with @ "
+                    "(sequence number, time in ms and values in millionths) or as binary frames"sv,
+     .handler =
+         [](std::string_view params) {
+             stream_mode mode;
+             if (params == "on"sv) {
+                 mode = stream_mode::text;
+             } else if (params == "on binary"sv) {
+                 mode = stream_mode::binary;
+             } else if (params == "off"sv) {
+                 mode = stream_mode::off;
+             } else {
+                 printk("invalid option\n");
+                 return;
+             }
+             // confirmation is printed before the first streamed measurement, which can't be written until the output
+             // of this command ends
+             printk("stream %s\n", mode == stream_mode::off ? "off" : "on");
+             stream_state = mode;
          }},
     {.name = "factory reset"sv,
      .description = "- performs factory reset"sv,
      .handler =
          [](std::string_view params) {
              k_mutex_lock(&main_buffer_mtx, K_FOREVER);
-             k_mutex_lock(&secondary_buffer_mtx, K_FOREVER);
              main_f_buffer->clear();
-             secondary_f_buffer->clear();
+             staging.clear();
+#ifdef CONFIG_ANTENVSENS_ROLLUPS
+             rollups::clear();
+#endif
              fram::clear();
              factory_reset_dialog();
              k_sem_give(&logger_sleep_smph);
              k_mutex_unlock(&main_buffer_mtx);
-             k_mutex_unlock(&secondary_buffer_mtx);
              printk("reset complete\n");
          }},
     {.name = "help"sv, .description = "- prints help"sv, .handler = [](std::string_view params) { print_help(); }}};
@@ -260,30 +950,43 @@ void io(void* arg1, void* arg2, void* arg3) {
     ARG_UNUSED(arg3);
 
     while (1) {
-        handle_command(console_getline());
+        const std::string_view line = terminal::getline();
+        terminal::lock_output();
+        handle_command(line);
+        terminal::unlock_output();
     }
 }
 
 int main(void) {
     gpio_pin_configure_dt(&led, GPIO_OUTPUT_ACTIVE);
 
-    console_getline_init();
+    terminal::init();
     sensors::init();
     fram::init();
     rtc::init();
 
-    static fram_buffer_t f_main_buf{fram::memory_map::env_main_buffer.begin(), fram::memory_map::env_main_buffer.end()};
+    static main_buffer_t f_main_buf{fram::memory_map::env_main_buffer.begin(),
+                                    fram::memory_map::env_main_buffer.end(),
+                                    fram::memory_map::env_main_buffer_checkpoint.begin()};
     main_f_buffer = &f_main_buf;
-
-    static fram_buffer_t f_secondary_buf{fram::memory_map::env_secondary_buffer.begin(),
-                                         fram::memory_map::env_secondary_buffer.end()};
-    secondary_f_buffer = &f_secondary_buf;
-
-    static user_config conf{fram::memory_map::device_name.begin(), fram::memory_map::period.begin()};
+#ifdef CONFIG_ANTENVSENS_ROLLUPS
+    rollups::init();
+#endif
+
+    static user_config conf{fram::memory_map::device_name.begin(),
+                            fram::memory_map::period.begin(),
+                            fram::memory_map::batch_size.begin(),
+                            fram::memory_map::deadbands.begin(),
+                            fram::memory_map::heartbeat.begin(),
+                            fram::memory_map::fast_period.begin(),
+                            fram::memory_map::rate_thresholds.begin(),
+                            fram::memory_map::oversampling.begin(),
+                            fram::memory_map::filter.begin(),
+                            fram::memory_map::ema_shift.begin(),
+                            fram::memory_map::period_ms.begin()};
     config = &conf;
 
     k_mutex_init(&main_buffer_mtx);
-    k_mutex_init(&secondary_buffer_mtx);
     k_sem_init(&logger_sleep_smph, 0, 1);
 
     k_thread_create(&logger_thread_data,
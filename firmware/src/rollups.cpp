@@ -0,0 +1,148 @@
+#include "rollups.h"
+#include "fram.h"
+#include "rtc.h"
+#include "terminal.h"
+
+#include <zephyr/kernel.h>
+
+#include <algorithm>
+
+namespace rollups {
+namespace {
+constexpr time_t minute = 60;
+constexpr time_t hour = 60 * minute;
+constexpr time_t day = 24 * hour;
+// millionths of sensor values per thousandth stored in records
+constexpr int64_t millionths_per_unit = 1000;
+
+buffer_t* minutes = nullptr;
+buffer_t* hours = nullptr;
+buffer_t* days = nullptr;
+accumulator minute_accumulator{minute};
+accumulator hour_accumulator{hour};
+accumulator day_accumulator{day};
+
+record to_record(const sensors::data_point& p) {
+    record r{.timestamp = static_cast<time_t>(p.timestamp_ms / MSEC_PER_SEC), .count = 1};
+    for (size_t i = 0; i < sensors::channel_count; i++) {
+        const sensor_value& sv = p.values[i];
+        const int64_t millionths = sv.val1 * 1000000LL + sv.val2;
+        const int64_t half = millionths < 0 ? -millionths_per_unit / 2 : millionths_per_unit / 2;
+        const int32_t value =
+            static_cast<int32_t>(std::clamp<int64_t>((millionths + half) / millionths_per_unit, INT32_MIN, INT32_MAX));
+        r.channels[i] = {.min = value, .max = value, .mean = value};
+    }
+    return r;
+}
+}
+
+void record::print(line_formatter& line) const {
+    static_assert(2 * (line_formatter::max_unsigned_size + 1) + line_formatter::max_time_ms_size +
+                      3 * sensors::channel_count * (1 + line_formatter::max_millionths_size) <=
+                  line_formatter::max_line_size);
+    line.put_time(timestamp);
+    line.put(',');
+    line.put_unsigned(count);
+    for (const channel_stats& c : channels) {
+        for (int32_t value : {c.min, c.max, c.mean}) {
+            line.put(',');
+            line.put_millionths(value * millionths_per_unit);
+        }
+    }
+    line.end_line();
+    terminal::write(line.data(), line.size());
+    line.clear();
+}
+
+std::optional<record> accumulator::add(const record& r) {
+    const time_t begin = r.timestamp - r.timestamp % m_interval;
+    std::optional<record> finished;
+    if (m_record.count != 0 && m_record.timestamp != begin) {
+        finished = m_record;
+        m_record.count = 0;
+    }
+
+    if (m_record.count == 0) {
+        m_record = r;
+        m_record.timestamp = begin;
+        for (size_t i = 0; i < sensors::channel_count; i++) {
+            m_sums[i] = static_cast<int64_t>(r.channels[i].mean) * r.count;
+        }
+        return finished;
+    }
+
+    m_record.count += r.count;
+    for (size_t i = 0; i < sensors::channel_count; i++) {
+        channel_stats& c = m_record.channels[i];
+        c.min = std::min(c.min, r.channels[i].min);
+        c.max = std::max(c.max, r.channels[i].max);
+        m_sums[i] += static_cast<int64_t>(r.channels[i].mean) * r.count;
+        c.mean = static_cast<int32_t>(m_sums[i] / m_record.count);
+    }
+    return finished;
+}
+
+void init() {
+    static buffer_t minutes_buf{fram::memory_map::env_minute_rollups.begin(),
+                                fram::memory_map::env_minute_rollups.end(),
+                                fram::memory_map::env_minute_rollups_checkpoint.begin()};
+    minutes = &minutes_buf;
+    static buffer_t hours_buf{fram::memory_map::env_hour_rollups.begin(),
+                              fram::memory_map::env_hour_rollups.end(),
+                              fram::memory_map::env_hour_rollups_checkpoint.begin()};
+    hours = &hours_buf;
+    static buffer_t days_buf{fram::memory_map::env_day_rollups.begin(),
+                             fram::memory_map::env_day_rollups.end(),
+                             fram::memory_map::env_day_rollups_checkpoint.begin()};
+    days = &days_buf;
+
+    // records of the current hour and day stored before startup
+    const time_t now = rtc::get_current_time();
+    const auto rebuild = [&](buffer_t& buffer, accumulator& acc, time_t interval) {
+        uint32_t sequence = buffer.find_first([&](const record& r) { return r.timestamp >= now - now % interval; });
+        buffer_t::snapshot s;
+        while (buffer.fetch(sequence, buffer.next_sequence(), s)) {
+            s.for_each([&](uint32_t, const record& r) { acc.add(r); });
+        }
+    };
+    rebuild(*minutes, hour_accumulator, hour);
+    rebuild(*hours, day_accumulator, day);
+}
+
+void add(const sensors::data_point& p) {
+    const std::optional<record> finished_minute = minute_accumulator.add(to_record(p));
+    if (!finished_minute) {
+        return;
+    }
+    minutes->push(*finished_minute);
+    const std::optional<record> finished_hour = hour_accumulator.add(*finished_minute);
+    if (!finished_hour) {
+        return;
+    }
+    hours->push(*finished_hour);
+    const std::optional<record> finished_day = day_accumulator.add(*finished_hour);
+    if (finished_day) {
+        days->push(*finished_day);
+    }
+}
+
+buffer_t& buffer(tier t) {
+    switch (t) {
+    case tier::minute:
+        return *minutes;
+    case tier::hour:
+        return *hours;
+    default:
+        return *days;
+    }
+}
+
+void clear() {
+    minutes->clear();
+    hours->clear();
+    days->clear();
+    minute_accumulator = accumulator{minute};
+    hour_accumulator = accumulator{hour};
+    day_accumulator = accumulator{day};
+}
+}
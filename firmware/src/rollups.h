@@ -0,0 +1,69 @@
+#ifndef ANTENVSENS_ROLLUPS_H
+#define ANTENVSENS_ROLLUPS_H
+#include "fram_buffer.h"
+#include "sensors.h"
+
+#include <cstdint>
+#include <ctime>
+#include <optional>
+
+/*
+Rollups summarize measurements over minutes, hours and days, so that long
+history can be kept in fram which holds raw measurements only from a short
+time. Every measurement is folded into the current minute record, finished
+minute records are stored in their own fram_buffer and folded into the current
+hour record, which is stored in another fram_buffer once the hour is finished
+and folded into the current day record in the same way. Records in RAM are lost
+on power loss, the current hour and day records are rebuilt from stored minute
+and hour records during startup, the current minute is summarized only from
+measurements taken after it.
+*/
+namespace rollups {
+
+struct channel_stats {
+    // values in thousandths, which keeps magnitudes up to about 2 million (e.g. pressure in Pa) in 32 bits, larger
+    // ones are saturated
+    int32_t min;
+    int32_t max;
+    int32_t mean;
+};
+
+struct record {
+    // beginning of summarized interval
+    time_t timestamp{};
+    // amount of summarized measurements
+    uint32_t count{};
+    // in the same order as values of sensors::data_point
+    channel_stats channels[sensors::channel_count]{};
+
+    // prints timestamp, amount of measurements and min, max and mean of every value in csv format after fields already
+    // put into @line
+    void print(line_formatter& line) const;
+};
+
+enum class tier { minute, hour, day };
+
+using buffer_t = fram_buffer<record>;
+
+// folds records into a record of interval of @interval seconds
+class accumulator {
+    time_t m_interval;
+    record m_record{};
+    // sums of values weighted by amount of measurements, used to compute means
+    int64_t m_sums[sensors::channel_count]{};
+
+  public:
+    explicit accumulator(time_t interval) : m_interval{interval} {}
+
+    // folds @r, returns the current record if @r belongs to another interval than it
+    std::optional<record> add(const record& r);
+};
+
+void init();
+// folds @p into rollups and stores finished records, has to be synchronized with accesses to buffers
+void add(const sensors::data_point& p);
+buffer_t& buffer(tier t);
+void clear();
+}
+
+#endif
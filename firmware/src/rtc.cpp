@@ -9,6 +9,7 @@
 #include <zephyr/sys/printk.h>
 #include <zephyr/sys/timeutil.h>
 
+#include <cerrno>
 #include <cstdio>
 
 namespace rtc {
@@ -46,6 +47,13 @@ time_t get_current_time() {
     return timeutil_timegm64(rtc_time_to_tm(&dt));
 }
 
+int64_t get_current_time_ms() {
+    rtc_time dt{};
+    rtc_get_time(rtc, &dt);
+
+    return timeutil_timegm64(rtc_time_to_tm(&dt)) * MSEC_PER_SEC + dt.tm_nsec / NSEC_PER_MSEC;
+}
+
 void print_time(time_t timestamp) {
     tm* tm = gmtime(&timestamp);
 
@@ -58,21 +66,44 @@ void print_time(time_t timestamp) {
            tm->tm_sec);
 }
 
-int set_current_time(const char* timestamp) {
-    rtc_time dt{};
+void print_time_ms(int64_t timestamp_ms) {
+    print_time(static_cast<time_t>(timestamp_ms / MSEC_PER_SEC));
+    if (timestamp_ms % MSEC_PER_SEC != 0) {
+        printk(".%03d", static_cast<int>(timestamp_ms % MSEC_PER_SEC));
+    }
+}
 
-    sscanf(timestamp,
-           "%04d-%02d-%02dT%02d:%02d:%02d",
-           &dt.tm_year,
-           &dt.tm_mon,
-           &dt.tm_mday,
-           &dt.tm_hour,
-           &dt.tm_min,
-           &dt.tm_sec);
+// returns amount of parsed fields
+static int scan_time(const char* timestamp, rtc_time& dt) {
+    const int fields = sscanf(timestamp,
+                              "%04d-%02d-%02dT%02d:%02d:%02d",
+                              &dt.tm_year,
+                              &dt.tm_mon,
+                              &dt.tm_mday,
+                              &dt.tm_hour,
+                              &dt.tm_min,
+                              &dt.tm_sec);
 
     dt.tm_year -= 1900;
     dt.tm_mon -= 1;
 
+    return fields;
+}
+
+int set_current_time(const char* timestamp) {
+    rtc_time dt{};
+    scan_time(timestamp, dt);
+
     return rtc_set_time(rtc, &dt);
 }
+
+int parse_time(const char* timestamp, time_t* result) {
+    rtc_time dt{};
+    if (scan_time(timestamp, dt) != 6) {
+        return -EINVAL;
+    }
+
+    *result = timeutil_timegm64(rtc_time_to_tm(&dt));
+    return 0;
+}
 }
\ No newline at end of file
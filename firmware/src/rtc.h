@@ -1,12 +1,18 @@
 #ifndef ANTENVSENS_RTC_H
 #define ANTENVSENS_RTC_H
+#include <cstdint>
 #include <ctime>
 
 namespace rtc {
 void init();
 int set_current_time(const char* timestamp);
+int parse_time(const char* timestamp, time_t* result);
 time_t get_current_time();
+// returns current time in milliseconds since epoch
+int64_t get_current_time_ms();
 void print_time(time_t timestamp);
+// prints time with milliseconds, which are omitted if timestamp is a whole second
+void print_time_ms(int64_t timestamp_ms);
 }
 
 #endif
\ No newline at end of file
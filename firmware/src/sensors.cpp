@@ -1,38 +1,108 @@
 #include "sensors.h"
 #include "rtc.h"
+#include "stats.h"
+#include "terminal.h"
 
+#include <zephyr/kernel.h>
 #include <zephyr/sys/printk.h>
 
+#include <array>
+
 namespace sensors {
-const device* const bme = DEVICE_DT_GET_ONE(bosch_bme280);
-const device* const sht = DEVICE_DT_GET_ONE(sensirion_sht4x);
+struct sensor_device {
+    sensor_id id;
+    std::string_view name;
+    const device* dev;
+};
 
-void init() {
-    if (!device_is_ready(bme)) {
-        printk("warning: bme280: not ready\n");
-        return;
+// sensors enabled in devicetree, in the order in which "get status" prints them
+constexpr sensor_device sensor_devices[] = {
+#if DT_HAS_COMPAT_STATUS_OKAY(sensirion_sht4x)
+    {sensor_id::sht4x, "sht45", DEVICE_DT_GET_ONE(sensirion_sht4x)},
+#endif
+#if DT_HAS_COMPAT_STATUS_OKAY(bosch_bme280)
+    {sensor_id::bme280, "bme280", DEVICE_DT_GET_ONE(bosch_bme280)},
+#endif
+};
+constexpr size_t sensor_count = std::size(sensor_devices);
+
+constexpr const device* device_of(sensor_id id) {
+    for (const sensor_device& s : sensor_devices) {
+        if (s.id == id) {
+            return s.dev;
+        }
+    }
+    return nullptr;
+}
+
+// Sample fetch blocks for the whole conversion time of sensor. Samples of all sensors but the first one are fetched
+// by a work queue while the calling thread fetches samples of the first one, so conversions run at the same time and
+// acquisition of two sensors takes as long as the slower one. Drivers only sleep while waiting for conversions, so
+// fetching from sensors concurrently doesn't conflict on the shared I2C bus, which is locked by the I2C driver for
+// every transfer
+constexpr auto acquisition_stack_size = 1024;
+// higher than priority of logger thread, so that conversions of the work queue are triggered first
+constexpr auto acquisition_priority = K_PRIO_PREEMPT(0);
+
+static K_THREAD_STACK_DEFINE(acquisition_stack_area, acquisition_stack_size);
+static k_work_q acquisition_queue;
+static k_work fetch_work;
+static k_sem fetched;
+// get_data is used by both logger and io threads
+static k_mutex acquisition_mtx;
+
+static void fetch_rest(k_work* work) {
+    ARG_UNUSED(work);
+    for (size_t i = 1; i < sensor_count; i++) {
+        sensor_sample_fetch(sensor_devices[i].dev);
     }
+    k_sem_give(&fetched);
+}
 
-    if (!device_is_ready(sht)) {
-        printk("warning: sht43: not ready\n");
-        return;
+void init() {
+    k_mutex_init(&acquisition_mtx);
+    k_sem_init(&fetched, 0, 1);
+    k_work_init(&fetch_work, fetch_rest);
+    k_work_queue_start(&acquisition_queue,
+                       acquisition_stack_area,
+                       K_THREAD_STACK_SIZEOF(acquisition_stack_area),
+                       acquisition_priority,
+                       nullptr);
+
+    for (const sensor_device& s : sensor_devices) {
+        if (!device_is_ready(s.dev)) {
+            printk("warning: %s: not ready\n", s.name.data());
+        }
     }
 }
 
 data_point get_data() {
     data_point p;
+    const stats::timer timer{stats::current.acquisition};
 
-    sensor_sample_fetch(bme);
-    sensor_sample_fetch(sht);
-
-    sensor_channel_get(bme, SENSOR_CHAN_AMBIENT_TEMP, &p.bme_temperature);
-    sensor_channel_get(bme, SENSOR_CHAN_PRESS, &p.bme_pressure);
-    sensor_channel_get(bme, SENSOR_CHAN_HUMIDITY, &p.bme_humidity);
+    k_mutex_lock(&acquisition_mtx, K_FOREVER);
+    if constexpr (sensor_count > 1) {
+        k_work_submit_to_queue(&acquisition_queue, &fetch_work);
+    }
+    sensor_sample_fetch(sensor_devices[0].dev);
+    if constexpr (sensor_count > 1) {
+        k_sem_take(&fetched, K_FOREVER);
+    }
 
-    sensor_channel_get(sht, SENSOR_CHAN_AMBIENT_TEMP, &p.sht_temperature);
-    sensor_channel_get(sht, SENSOR_CHAN_HUMIDITY, &p.sht_humidity);
+    // devices of channels are resolved at compile time
+    constexpr auto channel_devices = [] {
+        std::array<const device*, channel_count> devices{};
+        for (size_t i = 0; i < channel_count; i++) {
+            devices[i] = device_of(channels[i].sensor);
+        }
+        return devices;
+    }();
+    for (size_t i = 0; i < channel_count; i++) {
+        sensor_channel_get(channel_devices[i], channels[i].type, &p.values[i]);
+    }
+    k_mutex_unlock(&acquisition_mtx);
 
-    p.timestamp = rtc::get_current_time();
+    p.timestamp_ms = rtc::get_current_time_ms();
 
     return p;
 }
@@ -48,19 +118,37 @@ void data_point::print_value(const sensor_value& sv) const {
     printk("%d.%06d", integer_part, decimal_part);
 }
 
-void data_point::print() const {
-    rtc::print_time(timestamp);
-    auto print_comma_prepend_value = [&](sensor_value val) {
-        printk(",");
-        print_value(val);
-    };
-    print_comma_prepend_value(bme_temperature);
-    print_comma_prepend_value(bme_pressure);
-    print_comma_prepend_value(bme_humidity);
-    print_comma_prepend_value(sht_temperature);
-    print_comma_prepend_value(sht_humidity);
-    printk("\n");
+void data_point::print(line_formatter& line) const {
+    static_assert(line_formatter::max_unsigned_size + 1 + line_formatter::max_time_ms_size +
+                      channel_count * (1 + line_formatter::max_millionths_size) <=
+                  line_formatter::max_line_size);
+    line.put_time_ms(timestamp_ms);
+    for (const sensor_value& val : values) {
+        line.put(',');
+        line.put_millionths(val.val1 * 1000000LL + val.val2);
+    }
+    line.end_line();
+    terminal::write(line.data(), line.size());
+    line.clear();
+}
 
-    k_sleep(K_MSEC(10));
+void print_status(const data_point& p) {
+    for (const sensor_device& s : sensor_devices) {
+        printk("%s:\n", s.name.data());
+        for (size_t i = 0; i < channel_count; i++) {
+            if (channels[i].sensor == s.id) {
+                printk("  %s: ", channels[i].quantity.data());
+                p.print_value(p.values[i]);
+                printk("\n");
+            }
+        }
+    }
+}
+
+void print_schema() {
+    for (size_t i = 0; i < channel_count; i++) {
+        printk(i == 0 ? "%s" : ",%s", channels[i].name.data());
+    }
+    printk("\n");
 }
 }
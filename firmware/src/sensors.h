@@ -1,25 +1,67 @@
 #ifndef ANTENVSENS_SENSORS_H
 #define ANTENVSENS_SENSORS_H
+#include "line_formatter.h"
+
+#include <zephyr/devicetree.h>
 #include <zephyr/drivers/sensor.h>
 
+#include <cstdint>
 #include <ctime>
+#include <iterator>
+#include <string_view>
 
+/*
+Channels are registered at compile time from devicetree: every sensor enabled in
+devicetree contributes its channels to the channels table, which determines
+values stored in data_point, so boards without some sensor don't store (nor
+fetch and print) its values. Adding a sensor requires only adding it to
+sensor_id, its channels to the table and its device to sensors.cpp.
+*/
 namespace sensors {
 
+enum class sensor_id : uint8_t { sht4x, bme280 };
+
+struct channel {
+    // name used by commands and reported in schema
+    std::string_view name;
+    sensor_id sensor;
+    sensor_channel type;
+    // name of measured quantity printed by "get status"
+    std::string_view quantity;
+};
+
+// values of data_point in the order in which they are stored and printed
+inline constexpr channel channels[] = {
+#if DT_HAS_COMPAT_STATUS_OKAY(bosch_bme280)
+    {"bme_temperature", sensor_id::bme280, SENSOR_CHAN_AMBIENT_TEMP, "temperature"},
+    {"bme_pressure", sensor_id::bme280, SENSOR_CHAN_PRESS, "pressure"},
+    {"bme_humidity", sensor_id::bme280, SENSOR_CHAN_HUMIDITY, "humidity"},
+#endif
+#if DT_HAS_COMPAT_STATUS_OKAY(sensirion_sht4x)
+    {"sht_temperature", sensor_id::sht4x, SENSOR_CHAN_AMBIENT_TEMP, "temperature"},
+    {"sht_humidity", sensor_id::sht4x, SENSOR_CHAN_HUMIDITY, "humidity"},
+#endif
+};
+constexpr size_t channel_count = std::size(channels);
+
 struct data_point {
-    time_t timestamp{};
-    sensor_value bme_temperature{};
-    sensor_value bme_pressure{};
-    sensor_value bme_humidity{};
-    sensor_value sht_temperature{};
-    sensor_value sht_humidity{};
-
-    void print() const;
+    // milliseconds since epoch
+    int64_t timestamp_ms{};
+    // in the order of channels
+    sensor_value values[channel_count]{};
+
+    // prints timestamp and values separated with commas after fields already put into @line, consecutive data points
+    // are printed with the same line, so that it keeps date of the previous timestamp
+    void print(line_formatter& line) const;
     void print_value(const sensor_value& sv) const;
 };
 
 void init();
 data_point get_data();
+// prints values of @p grouped by sensors
+void print_status(const data_point& p);
+// prints names of channels separated with commas
+void print_schema();
 }
 
 #endif
@@ -0,0 +1,49 @@
+#ifndef ANTENVSENS_STAGING_RING_H
+#define ANTENVSENS_STAGING_RING_H
+#include <atomic>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+
+/*
+staging_ring is a fixed size circular buffer kept in RAM. A single producer can
+push elements concurrently with a single consumer popping them without any
+locking, positions of both ends are only ever advanced by their owners.
+*/
+template <typename T, size_t N>
+class staging_ring {
+    T m_elems[N];
+    // free running positions, element at position i is stored in m_elems[i % N]
+    std::atomic<uint32_t> m_head = 0;
+    std::atomic<uint32_t> m_tail = 0;
+
+  public:
+    constexpr static size_t capacity() { return N; }
+
+    size_t size() const { return m_head.load(std::memory_order_acquire) - m_tail.load(std::memory_order_acquire); }
+
+    // adds element to the ring, returns false if ring is full, may be called only by producer
+    bool push(const T& elem) {
+        const uint32_t head = m_head.load(std::memory_order_relaxed);
+        if (head - m_tail.load(std::memory_order_acquire) == N) {
+            return false;
+        }
+        m_elems[head % N] = elem;
+        m_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // invokes func for every element in ring in order of pushing and removes them, may be called only by consumer
+    void pop_all(std::invocable<const T&> auto&& func) {
+        const uint32_t head = m_head.load(std::memory_order_acquire);
+        for (uint32_t tail = m_tail.load(std::memory_order_relaxed); tail != head; tail++) {
+            func(m_elems[tail % N]);
+        }
+        m_tail.store(head, std::memory_order_release);
+    }
+
+    // removes all elements, may be called only by consumer
+    void clear() { m_tail.store(m_head.load(std::memory_order_acquire), std::memory_order_release); }
+};
+
+#endif
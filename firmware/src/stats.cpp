@@ -0,0 +1,104 @@
+#include "stats.h"
+
+#include <zephyr/sys/printk.h>
+
+#include <algorithm>
+#include <bit>
+
+namespace stats {
+counters current;
+
+static k_spinlock lock;
+// missed deadlines cleared from current counters by reset
+static uint32_t missed_before_reset = 0;
+
+void histogram::add(uint32_t us) {
+    const size_t bucket = std::min<size_t>(std::bit_width(us), bucket_count - 1);
+    K_SPINLOCK(&lock) {
+        m_buckets[bucket]++;
+        m_count++;
+        m_total_us += us;
+        m_max_us = us > m_max_us ? us : m_max_us;
+    }
+}
+
+void histogram::print(const char* name) const {
+    histogram copy;
+    K_SPINLOCK(&lock) {
+        copy = *this;
+    }
+    printk("%s: count=%u total_us=%llu max_us=%u buckets=",
+           name,
+           copy.m_count,
+           static_cast<unsigned long long>(copy.m_total_us),
+           copy.m_max_us);
+    for (size_t i = 0; i < bucket_count; i++) {
+        printk(i == 0 ? "%u" : ",%u", copy.m_buckets[i]);
+    }
+    printk("\n");
+}
+
+void io_counters::add(size_t size, uint32_t us, bool error) {
+    K_SPINLOCK(&lock) {
+        calls++;
+        bytes += size;
+        errors += error ? 1 : 0;
+    }
+    latency.add(us);
+}
+
+void io_counters::print(const char* name) const {
+    uint32_t c, b, e;
+    K_SPINLOCK(&lock) {
+        c = calls;
+        b = bytes;
+        e = errors;
+    }
+    printk("%s: calls=%u bytes=%u errors=%u\n", name, c, b, e);
+    latency.print(name);
+}
+
+void increment(uint32_t& counter, uint32_t value) {
+    K_SPINLOCK(&lock) {
+        counter += value;
+    }
+}
+
+uint32_t missed_deadlines_since_boot() {
+    uint32_t missed;
+    K_SPINLOCK(&lock) {
+        missed = missed_before_reset + current.missed_deadlines;
+    }
+    return missed;
+}
+
+void print() {
+    uint32_t missed_deadlines, flushes, staging_dropped, overwritten, stream_dropped;
+    K_SPINLOCK(&lock) {
+        missed_deadlines = current.missed_deadlines;
+        flushes = current.flushes;
+        staging_dropped = current.staging_dropped;
+        overwritten = current.overwritten;
+        stream_dropped = current.stream_dropped;
+    }
+    current.fram_reads.print("fram_read");
+    current.fram_writes.print("fram_write");
+    current.acquisition.print("acquisition");
+    current.push.print("push");
+    current.fetch.print("fetch");
+    current.mutex_wait.print("mutex_wait");
+    current.lateness.print("lateness");
+    printk("missed_deadlines: %u\n", missed_deadlines);
+    printk("flushes: %u\n", flushes);
+    printk("staging_dropped: %u\n", staging_dropped);
+    printk("overwritten: %u\n", overwritten);
+    printk("stream_dropped: %u\n", stream_dropped);
+}
+
+void reset() {
+    K_SPINLOCK(&lock) {
+        missed_before_reset += current.missed_deadlines;
+        current = counters{};
+    }
+}
+}
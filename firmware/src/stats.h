@@ -0,0 +1,88 @@
+#ifndef ANTENVSENS_STATS_H
+#define ANTENVSENS_STATS_H
+#include <zephyr/kernel.h>
+
+#include <cstddef>
+#include <cstdint>
+
+/*
+Runtime statistics collected since startup or the last reset. Latencies are
+counted in histograms with power of two buckets, bucket 0 counts latencies
+below 1 us, bucket i counts latencies in [2^(i-1), 2^i) us and the last one
+counts all longer latencies. Statistics are updated from multiple threads, so
+every update is done under a spinlock.
+*/
+namespace stats {
+class histogram {
+    constexpr static size_t bucket_count = 20;
+
+    uint32_t m_buckets[bucket_count]{};
+    uint32_t m_count = 0;
+    uint32_t m_max_us = 0;
+    uint64_t m_total_us = 0;
+
+  public:
+    void add(uint32_t us);
+    // prints "<name>: count=<count> total_us=<sum> max_us=<max> buckets=<counts separated with commas>"
+    void print(const char* name) const;
+};
+
+// measures time between its construction and destruction
+class timer {
+    histogram& m_histogram;
+    uint32_t m_start;
+
+  public:
+    explicit timer(histogram& h) : m_histogram{h}, m_start{k_cycle_get_32()} {}
+    ~timer() { m_histogram.add(k_cyc_to_us_floor32(k_cycle_get_32() - m_start)); }
+
+    timer(const timer&) = delete;
+    timer& operator=(const timer&) = delete;
+};
+
+struct io_counters {
+    uint32_t calls = 0;
+    uint32_t bytes = 0;
+    uint32_t errors = 0;
+    histogram latency;
+
+    void add(size_t size, uint32_t us, bool error);
+    // prints "<name>: calls=<calls> bytes=<bytes> errors=<errors>" followed by latency histogram
+    void print(const char* name) const;
+};
+
+struct counters {
+    io_counters fram_reads;
+    io_counters fram_writes;
+    // sensors::get_data
+    histogram acquisition;
+    // pushes to main buffer
+    histogram push;
+    // copying windows of main buffer for exports
+    histogram fetch;
+    // time logger waits for main buffer mutex
+    histogram mutex_wait;
+    // delays of measurements after their deadlines
+    histogram lateness;
+    uint32_t missed_deadlines = 0;
+    // flushes of staging ring into main buffer, the amount of flushed measurements is the count of pushes
+    uint32_t flushes = 0;
+    // measurements dropped because staging ring was full
+    uint32_t staging_dropped = 0;
+    // entries overwritten in main buffer before being removed
+    uint32_t overwritten = 0;
+    // measurements left out of stream because console wasn't ready
+    uint32_t stream_dropped = 0;
+};
+
+extern counters current;
+
+// increments @counter under the statistics lock
+void increment(uint32_t& counter, uint32_t value = 1);
+// returns missed deadlines counted since boot, including those cleared by reset
+uint32_t missed_deadlines_since_boot();
+void print();
+void reset();
+}
+
+#endif
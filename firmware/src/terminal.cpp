@@ -0,0 +1,226 @@
+#include "terminal.h"
+
+#include <zephyr/console/tty.h>
+#include <zephyr/drivers/uart.h>
+#include <zephyr/logging/log_backend.h>
+#include <zephyr/logging/log_backend_std.h>
+#include <zephyr/logging/log_output.h>
+#include <zephyr/sys/printk-hooks.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstdint>
+#include <optional>
+
+namespace terminal {
+const device* const uart = DEVICE_DT_GET(DT_CHOSEN(zephyr_console));
+
+constexpr size_t tx_buffer_size = 1024;
+constexpr size_t rx_buffer_size = 256;
+constexpr size_t max_line_length = 256;
+constexpr uint32_t supported_baudrates[] = {
+    9600, 19200, 38400, 57600, 115200, 230400, 460800, 921600, 1000000, 2000000};
+// time for host to switch its baud rate and send ping
+constexpr int32_t ping_timeout_ms = 3 * MSEC_PER_SEC;
+// initial baud rate is restored if nothing is received for this time after switching it
+constexpr int32_t idle_timeout_ms = 60 * MSEC_PER_SEC;
+
+static tty_serial tty;
+static uint8_t tx_buffer[tx_buffer_size];
+static uint8_t rx_buffer[rx_buffer_size];
+static uart_config initial_config;
+static uart_config current_config;
+static k_mutex output_mtx;
+// set once transmit ring buffer is ready and cleared on panic, log output is written by polling uart otherwise
+static std::atomic<bool> interrupt_driven{false};
+
+static void write_char(char ch) { tty_write(&tty, &ch, 1); }
+
+// printk output is translated the same way as by uart console driver
+static int printk_hook(int ch) {
+    if (ch == '\n') {
+        write_char('\r');
+    }
+    write_char(ch);
+    return ch;
+}
+
+void init() {
+    k_mutex_init(&output_mtx);
+    tty_init(&tty, uart);
+    tty_set_tx_buf(&tty, tx_buffer, sizeof(tx_buffer));
+    tty_set_rx_buf(&tty, rx_buffer, sizeof(rx_buffer));
+    __printk_hook_install(printk_hook);
+    uart_config_get(uart, &initial_config);
+    current_config = initial_config;
+    interrupt_driven = true;
+}
+
+void write(const void* data, size_t size) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    while (size > 0) {
+        const ssize_t written = tty_write(&tty, bytes, size);
+        if (written <= 0) {
+            return;
+        }
+        bytes += written;
+        size -= written;
+    }
+}
+
+void lock_output() { k_mutex_lock(&output_mtx, K_FOREVER); }
+
+void unlock_output() { k_mutex_unlock(&output_mtx); }
+
+bool try_write(const void* data, size_t size) {
+    if (k_mutex_lock(&output_mtx, K_NO_WAIT) != 0) {
+        return false;
+    }
+    // free space of transmit buffer is counted by tx_sem, so writing fewer bytes than its count doesn't block
+    const bool fits = k_sem_count_get(&tty.tx_sem) >= size;
+    if (fits) {
+        write(data, size);
+    }
+    k_mutex_unlock(&output_mtx);
+    return fits;
+}
+
+#ifdef CONFIG_LOG
+// Log messages are written by logging thread through the transmit ring buffer as well, each message with output
+// locked, so that they aren't mixed into output of commands (e.g. into binary frames)
+static int log_char_out(uint8_t* data, size_t length, void* ctx) {
+    if (interrupt_driven) {
+        write(data, length);
+    } else {
+        for (size_t i = 0; i < length; i++) {
+            uart_poll_out(uart, data[i]);
+        }
+    }
+    return static_cast<int>(length);
+}
+
+static uint8_t log_output_buf[64];
+LOG_OUTPUT_DEFINE(log_output_terminal, log_char_out, log_output_buf, sizeof(log_output_buf));
+
+// runs @output with output locked, unless it is written by polling uart
+static void locked_log_output(auto&& output) {
+    const bool lock = interrupt_driven;
+    if (lock) {
+        lock_output();
+    }
+    output();
+    if (lock) {
+        unlock_output();
+    }
+}
+
+static void log_process(const log_backend* const backend, log_msg_generic* msg) {
+    locked_log_output([&] { log_output_msg_process(&log_output_terminal, &msg->log, log_backend_std_get_flags()); });
+}
+
+static void log_dropped(const log_backend* const backend, uint32_t count) {
+    locked_log_output([&] { log_output_dropped_process(&log_output_terminal, count); });
+}
+
+// interrupts can't be relied on after panic
+static void log_panic(const log_backend* const backend) {
+    interrupt_driven = false;
+    log_output_flush(&log_output_terminal);
+}
+
+static const log_backend_api log_backend_terminal_api = {
+    .process = log_process, .dropped = log_dropped, .panic = log_panic};
+LOG_BACKEND_DEFINE(log_backend_terminal, log_backend_terminal_api, true);
+#endif
+
+// reads a byte waiting at most @timeout_ms (or forever if it's SYS_FOREVER_MS), returns false on timeout
+static bool read_char(char& ch, int32_t timeout_ms) {
+    tty_set_rx_timeout(&tty, timeout_ms);
+    return tty_read(&tty, &ch, 1) == 1;
+}
+
+// reads line, returns nothing if no byte is received for @timeout_ms
+static std::optional<std::string_view> read_line(int32_t timeout_ms) {
+    static char line[max_line_length + 1];
+    // '\n' following '\r' ends the same line
+    static bool after_cr = false;
+    size_t length = 0;
+    while (true) {
+        char ch;
+        if (!read_char(ch, timeout_ms)) {
+            return std::nullopt;
+        }
+        if (ch == '\n' && after_cr) {
+            after_cr = false;
+            continue;
+        }
+        after_cr = ch == '\r';
+        if (ch == '\r' || ch == '\n') {
+            write("\r\n", 2);
+            line[length] = '\0';
+            return std::string_view{line, length};
+        }
+        if (ch == '\b' || ch == 0x7f) {
+            if (length > 0) {
+                length--;
+                write("\b \b", 3);
+            }
+        } else if (std::isprint(static_cast<unsigned char>(ch)) && length < max_line_length) {
+            line[length++] = ch;
+            write_char(ch);
+        }
+    }
+}
+
+// waits until all pending output is transmitted
+static void flush() {
+    while (tty.tx_get != tty.tx_put || !uart_irq_tx_complete(uart)) {
+        k_sleep(K_MSEC(1));
+    }
+}
+
+static void configure(const uart_config& config) {
+    flush();
+    uart_configure(uart, &config);
+    current_config = config;
+    // bytes received during switching are garbage
+    char ch;
+    while (read_char(ch, 0)) {
+    }
+}
+
+std::string_view getline() {
+    while (true) {
+        const bool switched = current_config.baudrate != initial_config.baudrate;
+        const std::optional<std::string_view> line = read_line(switched ? idle_timeout_ms : SYS_FOREVER_MS);
+        if (line) {
+            return *line;
+        }
+        configure(initial_config);
+    }
+}
+
+bool is_supported_baudrate(uint32_t baudrate) {
+    return std::find(std::begin(supported_baudrates), std::end(supported_baudrates), baudrate) !=
+           std::end(supported_baudrates);
+}
+
+bool switch_baudrate(uint32_t baudrate) {
+    const uart_config previous_config = current_config;
+    uart_config config = current_config;
+    config.baudrate = baudrate;
+    configure(config);
+
+    const int64_t deadline = k_uptime_get() + ping_timeout_ms;
+    for (int64_t now = k_uptime_get(); now < deadline; now = k_uptime_get()) {
+        // lines garbled by switching are skipped
+        const std::optional<std::string_view> line = read_line(deadline - now);
+        if (line == "ping") {
+            return true;
+        }
+    }
+    configure(previous_config);
+    return false;
+}
+}
@@ -0,0 +1,36 @@
+#ifndef ANTENVSENS_TERMINAL_H
+#define ANTENVSENS_TERMINAL_H
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+/*
+Console uart is driven by interrupts. Output of printk, log messages and binary
+frames is put into a transmit ring buffer drained by uart interrupts, so
+printing thread sleeps instead of busy waiting while uart is busy, and it is
+blocked only when the ring buffer is full. Received bytes are collected into a
+receive ring buffer and read into lines by getline.
+*/
+namespace terminal {
+void init();
+// writes raw bytes, without newline translation
+void write(const void* data, size_t size);
+// Output of a command is written with the output locked, so that output of other threads written with try_write doesn't
+// get mixed into it
+void lock_output();
+void unlock_output();
+// writes raw bytes only if it can be done without waiting, i.e. output isn't locked by another thread and transmit
+// buffer has room for all of them, returns false if nothing was written
+bool try_write(const void* data, size_t size);
+// reads line echoing it back, returns it without line terminator, the line is valid until the next invocation and is
+// null terminated. If baud rate was switched and nothing is received for a minute, the initial baud rate is restored,
+// so that device can't stay unreachable after host loses the connection
+std::string_view getline();
+
+bool is_supported_baudrate(uint32_t baudrate);
+// Switches uart to @baudrate after transmitting pending output and waits for host to send "ping" line with it. If
+// ping isn't received within a few seconds the previous baud rate is restored. Returns true if baud rate was switched
+bool switch_baudrate(uint32_t baudrate);
+}
+
+#endif
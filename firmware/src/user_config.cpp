@@ -1,23 +1,134 @@
 #include "user_config.h"
 
+#include <zephyr/kernel.h>
+
 #include <algorithm>
 #include <cstring>
 
-user_config::user_config(fram::addr_t name_addr, fram::addr_t period_addr)
-    : m_name_addr{name_addr}, m_period_addr(period_addr) {
+static uint32_t rounded_up_seconds(uint32_t ms) { return ms / MSEC_PER_SEC + (ms % MSEC_PER_SEC != 0); }
+
+user_config::user_config(fram::addr_t name_addr,
+                         fram::addr_t period_addr,
+                         fram::addr_t batch_size_addr,
+                         fram::addr_t deadbands_addr,
+                         fram::addr_t heartbeat_addr,
+                         fram::addr_t fast_period_addr,
+                         fram::addr_t rate_thresholds_addr,
+                         fram::addr_t oversampling_addr,
+                         fram::addr_t filter_addr,
+                         fram::addr_t ema_shift_addr,
+                         fram::addr_t period_ms_addr)
+    : m_name_addr{name_addr},
+      m_period_addr(period_addr),
+      m_batch_size_addr{batch_size_addr},
+      m_deadbands_addr{deadbands_addr},
+      m_heartbeat_addr{heartbeat_addr},
+      m_fast_period_addr{fast_period_addr},
+      m_rate_thresholds_addr{rate_thresholds_addr},
+      m_oversampling_addr{oversampling_addr},
+      m_filter_addr{filter_addr},
+      m_ema_shift_addr{ema_shift_addr},
+      m_period_ms_addr{period_ms_addr} {
+    static_assert(sizeof(m_deadbands) <= fram::memory_map::deadbands.size());
+    static_assert(sizeof(m_rate_thresholds) <= fram::memory_map::rate_thresholds.size());
     fram::read(m_name_addr, m_name);
     m_name[sizeof(m_name) - 1] = '\0';
     m_name_len = strlen(m_name);
-    fram::read(m_period_addr, m_period);
-    m_period = std::max(m_period, min_period);
+    // Period in milliseconds is used only if it matches period in seconds written along with it, otherwise it was
+    // never written and the period in seconds comes from earlier firmware (or fram is unset)
+    const uint32_t period_s = fram::read<uint32_t>(m_period_addr);
+    fram::read(m_period_ms_addr, m_period_ms);
+    if (m_period_ms < min_period_ms || period_s != rounded_up_seconds(m_period_ms)) {
+        m_period_ms = period_s != 0 && period_s <= UINT32_MAX / MSEC_PER_SEC ? period_s * MSEC_PER_SEC
+                                                                               : default_period_ms;
+    }
+    fram::read(m_batch_size_addr, m_batch_size);
+    m_batch_size = std::clamp(m_batch_size, min_batch_size, max_batch_size);
+    fram::read(m_deadbands_addr, m_deadbands);
+    for (int32_t& deadband : m_deadbands) {
+        deadband = std::max(deadband, 0);
+    }
+    fram::read(m_heartbeat_addr, m_heartbeat);
+    m_heartbeat = std::max(m_heartbeat, min_heartbeat);
+    fram::read(m_fast_period_addr, m_fast_period_ms);
+    m_fast_period_ms = m_fast_period_ms == 0 ? 0 : std::max(m_fast_period_ms, min_period_ms);
+    fram::read(m_rate_thresholds_addr, m_rate_thresholds);
+    for (int32_t& threshold : m_rate_thresholds) {
+        threshold = std::max(threshold, 0);
+    }
+    fram::read(m_oversampling_addr, m_oversampling);
+    m_oversampling = std::clamp<uint32_t>(m_oversampling, 1, filter::max_samples);
+    fram::read(m_filter_addr, m_filter);
+    if (m_filter != filter::kernel::median && m_filter != filter::kernel::ema) {
+        m_filter = filter::kernel::mean;
+    }
+    fram::read(m_ema_shift_addr, m_ema_shift);
+    m_ema_shift = std::clamp(m_ema_shift, filter::min_ema_shift, filter::max_ema_shift);
+}
+
+void user_config::set_period_ms(uint32_t period_ms) {
+    m_period_ms = std::max(period_ms, min_period_ms);
+    fram::write(m_period_ms_addr, m_period_ms);
+    fram::write(m_period_addr, rounded_up_seconds(m_period_ms));
+}
+
+uint32_t user_config::get_period_ms() const { return m_period_ms; }
+
+void user_config::set_batch_size(uint32_t batch_size) {
+    m_batch_size = std::clamp(batch_size, min_batch_size, max_batch_size);
+    fram::write(m_batch_size_addr, m_batch_size);
+}
+
+uint32_t user_config::get_batch_size() const { return m_batch_size; }
+
+void user_config::set_deadband(size_t channel, int32_t deadband) {
+    m_deadbands[channel] = std::max(deadband, 0);
+    fram::write(m_deadbands_addr, m_deadbands);
+}
+
+int32_t user_config::get_deadband(size_t channel) const { return m_deadbands[channel]; }
+
+void user_config::set_heartbeat(uint32_t heartbeat) {
+    m_heartbeat = std::max(heartbeat, min_heartbeat);
+    fram::write(m_heartbeat_addr, m_heartbeat);
 }
 
-void user_config::set_period(uint32_t period) {
-    m_period = std::max(period, min_period);
-    fram::write(m_period_addr, period);
+uint32_t user_config::get_heartbeat() const { return m_heartbeat; }
+
+void user_config::set_fast_period_ms(uint32_t fast_period_ms) {
+    m_fast_period_ms = fast_period_ms == 0 ? 0 : std::max(fast_period_ms, min_period_ms);
+    fram::write(m_fast_period_addr, m_fast_period_ms);
+}
+
+uint32_t user_config::get_fast_period_ms() const { return m_fast_period_ms; }
+
+void user_config::set_rate_threshold(size_t channel, int32_t threshold) {
+    m_rate_thresholds[channel] = std::max(threshold, 0);
+    fram::write(m_rate_thresholds_addr, m_rate_thresholds);
+}
+
+int32_t user_config::get_rate_threshold(size_t channel) const { return m_rate_thresholds[channel]; }
+
+void user_config::set_oversampling(uint32_t oversampling) {
+    m_oversampling = std::clamp<uint32_t>(oversampling, 1, filter::max_samples);
+    fram::write(m_oversampling_addr, m_oversampling);
+}
+
+uint32_t user_config::get_oversampling() const { return m_oversampling; }
+
+void user_config::set_filter(filter::kernel filter) {
+    m_filter = filter;
+    fram::write(m_filter_addr, m_filter);
+}
+
+filter::kernel user_config::get_filter() const { return m_filter; }
+
+void user_config::set_ema_shift(uint32_t ema_shift) {
+    m_ema_shift = std::clamp(ema_shift, filter::min_ema_shift, filter::max_ema_shift);
+    fram::write(m_ema_shift_addr, m_ema_shift);
 }
 
-uint32_t user_config::get_period() const { return m_period; }
+uint32_t user_config::get_ema_shift() const { return m_ema_shift; }
 
 void user_config::set_name(std::string_view name) {
     m_name_len = std::min(name.size() + 1, sizeof(m_name)); // +1 to include \0
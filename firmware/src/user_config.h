@@ -1,24 +1,81 @@
 #ifndef ANTENVSENS_USER_CONFIG_H
 #define ANTENVSENS_USER_CONFIG_H
+#include "filter.h"
 #include "fram.h"
+#include "sensors.h"
 
 #include <string_view>
 
 class user_config {
-    constexpr static uint32_t min_period = 1;
+    // 20 Hz
+    constexpr static uint32_t min_period_ms = 50;
+    constexpr static uint32_t default_period_ms = 1000;
 
+  public:
+    constexpr static uint32_t min_batch_size = 1;
+    constexpr static uint32_t max_batch_size = CONFIG_ANTENVSENS_STAGING_SIZE;
+    constexpr static uint32_t min_heartbeat = 1;
+
+  private:
     fram::addr_t m_name_addr;
     fram::addr_t m_period_addr;
+    fram::addr_t m_batch_size_addr;
+    fram::addr_t m_deadbands_addr;
+    fram::addr_t m_heartbeat_addr;
+    fram::addr_t m_fast_period_addr;
+    fram::addr_t m_rate_thresholds_addr;
+    fram::addr_t m_oversampling_addr;
+    fram::addr_t m_filter_addr;
+    fram::addr_t m_ema_shift_addr;
+    fram::addr_t m_period_ms_addr;
 
     char m_name[fram::memory_map::device_name.size()];
     size_t m_name_len;
-    uint32_t m_period;
+    uint32_t m_period_ms;
+    uint32_t m_batch_size;
+    // in millionths of units of sensor values
+    int32_t m_deadbands[sensors::channel_count];
+    uint32_t m_heartbeat;
+    // 0 disables adaptive mode
+    uint32_t m_fast_period_ms;
+    // in millionths of units of sensor values per second
+    int32_t m_rate_thresholds[sensors::channel_count];
+    // amount of sub-samples reduced into every stored measurement
+    uint32_t m_oversampling;
+    filter::kernel m_filter;
+    uint32_t m_ema_shift;
 
   public:
-    user_config(fram::addr_t name_addr, fram::addr_t period_addr);
+    user_config(fram::addr_t name_addr,
+                fram::addr_t period_addr,
+                fram::addr_t batch_size_addr,
+                fram::addr_t deadbands_addr,
+                fram::addr_t heartbeat_addr,
+                fram::addr_t fast_period_addr,
+                fram::addr_t rate_thresholds_addr,
+                fram::addr_t oversampling_addr,
+                fram::addr_t filter_addr,
+                fram::addr_t ema_shift_addr,
+                fram::addr_t period_ms_addr);
 
-    void set_period(uint32_t period);
-    uint32_t get_period() const;
+    void set_period_ms(uint32_t period_ms);
+    uint32_t get_period_ms() const;
+    void set_batch_size(uint32_t batch_size);
+    uint32_t get_batch_size() const;
+    void set_deadband(size_t channel, int32_t deadband);
+    int32_t get_deadband(size_t channel) const;
+    void set_heartbeat(uint32_t heartbeat);
+    uint32_t get_heartbeat() const;
+    void set_fast_period_ms(uint32_t fast_period_ms);
+    uint32_t get_fast_period_ms() const;
+    void set_rate_threshold(size_t channel, int32_t threshold);
+    int32_t get_rate_threshold(size_t channel) const;
+    void set_oversampling(uint32_t oversampling);
+    uint32_t get_oversampling() const;
+    void set_filter(filter::kernel filter);
+    filter::kernel get_filter() const;
+    void set_ema_shift(uint32_t ema_shift);
+    uint32_t get_ema_shift() const;
     void set_name(std::string_view name);
     std::string_view get_name() const;
 };
@@ -0,0 +1,393 @@
+#include "compact_buffer.h"
+#include "fram.h"
+#include "fram_buffer.h"
+#include "fram_sim.h"
+#include "sensors.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+using namespace std::literals;
+
+using buffer_t = fram_buffer<sensors::data_point>;
+
+constexpr auto buffer_region = fram::memory_map::env_main_buffer;
+constexpr auto checkpoint_region = fram::memory_map::env_main_buffer_checkpoint;
+// amount of elements pushed in push benchmark
+constexpr size_t pushed_elements = 256;
+
+enum class fill_level { empty, half_full, wrapped };
+
+static const char* fill_level_name(fill_level level) {
+    switch (level) {
+    case fill_level::empty:
+        return "empty";
+    case fill_level::half_full:
+        return "half-full";
+    case fill_level::wrapped:
+        return "wrapped";
+    }
+    return "";
+}
+
+static sensors::data_point make_data_point(uint32_t i) {
+    return {.timestamp_ms = (1700000000 + static_cast<int64_t>(i)) * 1000,
+            .values = {{25, static_cast<int32_t>(i % 100 * 10000)},
+                       {99, static_cast<int32_t>(i * 7919 % 1000000)},
+                       {45, static_cast<int32_t>(i % 1024 * 976)},
+                       {24, static_cast<int32_t>(i % 400 * 2670)},
+                       {46, static_cast<int32_t>(i % 300 * 1907)}}};
+}
+
+static std::unique_ptr<buffer_t> make_buffer() {
+    return std::make_unique<buffer_t>(buffer_region.begin(), buffer_region.end(), checkpoint_region.begin());
+}
+
+// clears fram and fills buffer to @level, returns amount of elements in buffer
+static size_t prepare(fill_level level) {
+    fram::clear();
+    auto buffer = make_buffer();
+    const size_t capacity = buffer->capacity();
+    size_t count = 0;
+    switch (level) {
+    case fill_level::empty:
+        break;
+    case fill_level::half_full:
+        count = capacity / 2;
+        break;
+    case fill_level::wrapped:
+        count = capacity * 3 / 2;
+        break;
+    }
+    for (size_t i = 0; i < count; i++) {
+        buffer->push(make_data_point(i));
+    }
+    return buffer->size();
+}
+
+static bool failed = false;
+
+static void check(bool condition, const char* what, fill_level level) {
+    if (!condition) {
+        fprintf(stderr, "check failed: %s (%s)\n", what, fill_level_name(level));
+        failed = true;
+    }
+}
+
+// runs @setup followed by measured @body @repetitions times and prints the fastest run, counters don't depend on
+// the run, @operations is amount of operations performed by @body
+static void measure(const char* name,
+                    fill_level level,
+                    size_t operations,
+                    int repetitions,
+                    const std::function<void()>& setup,
+                    const std::function<void()>& body) {
+    std::optional<double> best_ns;
+    fram::sim::counters counters{};
+    for (int i = 0; i < repetitions; i++) {
+        setup();
+        fram::sim::reset_counters();
+        const auto start = std::chrono::steady_clock::now();
+        body();
+        const auto stop = std::chrono::steady_clock::now();
+        counters = fram::sim::get_counters();
+        const double ns = std::chrono::duration<double, std::nano>(stop - start).count();
+        best_ns = best_ns ? std::min(*best_ns, ns) : ns;
+    }
+
+    const double ops = std::max<size_t>(operations, 1);
+    printf("%-22s %-10s %8zu %12.0f %10.1f %10.1f %12.1f %12.1f %10.3f\n",
+           name,
+           fill_level_name(level),
+           operations,
+           *best_ns / ops,
+           counters.reads / ops,
+           counters.writes / ops,
+           counters.bytes_read / ops,
+           counters.bytes_written / ops,
+           counters.bus_ms() / ops);
+}
+
+static void run(fill_level level, int repetitions) {
+    std::unique_ptr<buffer_t> buffer;
+    size_t size = 0;
+    auto prepare_buffer = [&] {
+        buffer.reset();
+        size = prepare(level);
+        buffer = make_buffer();
+    };
+
+    uint32_t next = 0;
+    measure(
+        "push",
+        level,
+        pushed_elements,
+        repetitions,
+        [&] {
+            prepare_buffer();
+            next = buffer->next_sequence();
+        },
+        [&] {
+            for (size_t i = 0; i < pushed_elements; i++) {
+                buffer->push(make_data_point(next + i));
+            }
+        });
+    check(buffer->next_sequence() == next + pushed_elements, "push sequence numbers", level);
+
+    size_t visited = 0;
+    measure("peek_all", level, size, repetitions, prepare_buffer, [&] {
+        visited = 0;
+        buffer->peek_all([&](uint32_t, sensors::data_point&) { visited++; });
+    });
+    check(visited == size, "peek_all visits every element", level);
+
+    measure("pop_all", level, size, repetitions, prepare_buffer, [&] {
+        visited = 0;
+        buffer->pop_all([&](sensors::data_point&) { visited++; });
+    });
+    check(visited == size && buffer->size() == 0, "pop_all removes every element", level);
+
+    measure("clear", level, 1, repetitions, prepare_buffer, [&] { buffer->clear(); });
+    check(buffer->size() == 0, "clear removes every element", level);
+
+    auto prepare_recovery = [&] {
+        buffer.reset();
+        size = prepare(level);
+    };
+    measure("recovery", level, 1, repetitions, prepare_recovery, [&] { buffer = make_buffer(); });
+    check(buffer->size() == size, "recovery from checkpoint", level);
+
+    measure(
+        "recovery (full scan)",
+        level,
+        1,
+        repetitions,
+        [&] {
+            prepare_recovery();
+            const uint8_t zeros[checkpoint_region.size()]{};
+            fram::write_raw(checkpoint_region.begin(), zeros, sizeof(zeros));
+        },
+        [&] { buffer = make_buffer(); });
+    check(buffer->size() == size, "recovery from scan", level);
+}
+
+static std::unique_ptr<compact_buffer> make_compact_buffer() {
+    return std::make_unique<compact_buffer>(buffer_region.begin(), buffer_region.end(), checkpoint_region.begin());
+}
+
+// returns amount of samples pushed into empty compact_buffer until its oldest block is overwritten
+static size_t compact_wrap_count() {
+    static size_t count = 0;
+    if (count == 0) {
+        fram::clear();
+        auto buffer = make_compact_buffer();
+        while (buffer->first_sequence() == 0) {
+            buffer->push(make_data_point(count++));
+        }
+    }
+    return count;
+}
+
+// clears fram and fills compact_buffer to @level, returns amount of samples in buffer
+static size_t prepare_compact(fill_level level) {
+    size_t count = 0;
+    switch (level) {
+    case fill_level::empty:
+        break;
+    case fill_level::half_full:
+        count = compact_wrap_count() / 2;
+        break;
+    case fill_level::wrapped:
+        count = compact_wrap_count() * 3 / 2;
+        break;
+    }
+    fram::clear();
+    auto buffer = make_compact_buffer();
+    for (size_t i = 0; i < count; i++) {
+        buffer->push(make_data_point(i));
+    }
+    return buffer->next_sequence() - buffer->first_sequence();
+}
+
+static std::vector<std::pair<uint32_t, sensors::data_point>> read_compact(compact_buffer& buffer) {
+    std::vector<std::pair<uint32_t, sensors::data_point>> samples;
+    uint32_t sequence = buffer.first_sequence();
+    compact_buffer::snapshot s;
+    while (buffer.fetch(sequence, buffer.next_sequence(), s)) {
+        s.for_each([&](uint32_t fetched, sensors::data_point& p) { samples.emplace_back(fetched, p); });
+    }
+    return samples;
+}
+
+// compact_buffer stores values as fixed point numbers, so they are compared as such, generated data points aren't
+// normalized to val2 below 10^6
+static bool same_values(const sensors::data_point& a, const sensors::data_point& b) {
+    auto fixed_point = [](const sensor_value& sv) { return sv.val1 * 1000000LL + sv.val2; };
+    return a.timestamp_ms == b.timestamp_ms && std::ranges::equal(a.values, b.values, {}, fixed_point, fixed_point);
+}
+
+// returns true if @samples are consecutive data points pushed by prepare_compact, starting from @first
+static bool are_pushed_samples(const std::vector<std::pair<uint32_t, sensors::data_point>>& samples, uint32_t first) {
+    for (size_t i = 0; i < samples.size(); i++) {
+        if (samples[i].first != first + i || !same_values(samples[i].second, make_data_point(first + i))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void run_compact(fill_level level, int repetitions) {
+    std::unique_ptr<compact_buffer> buffer;
+    size_t size = 0;
+    auto prepare_buffer = [&] {
+        buffer.reset();
+        size = prepare_compact(level);
+        buffer = make_compact_buffer();
+    };
+
+    uint32_t next = 0;
+    measure(
+        "compact push",
+        level,
+        pushed_elements,
+        repetitions,
+        [&] {
+            prepare_buffer();
+            next = buffer->next_sequence();
+        },
+        [&] {
+            for (size_t i = 0; i < pushed_elements; i++) {
+                buffer->push(make_data_point(next + i));
+            }
+        });
+    check(buffer->next_sequence() == next + pushed_elements, "compact push sequence numbers", level);
+
+    std::vector<std::pair<uint32_t, sensors::data_point>> samples;
+    measure("compact fetch", level, size, repetitions, prepare_buffer, [&] { samples = read_compact(*buffer); });
+    check(samples.size() == size && are_pushed_samples(samples, buffer->first_sequence()),
+          "compact fetch returns every sample",
+          level);
+
+    measure(
+        "compact recovery",
+        level,
+        1,
+        repetitions,
+        [&] {
+            buffer.reset();
+            size = prepare_compact(level);
+        },
+        [&] { buffer = make_compact_buffer(); });
+    check(buffer->next_sequence() - buffer->first_sequence() == size && are_pushed_samples(read_compact(*buffer),
+                                                                                           buffer->first_sequence()),
+          "compact recovery",
+          level);
+}
+
+// Loses power at every fram write of every push until a few open blocks were rolled over into fram_buffer, with the
+// interrupted write torn at a few sizes. The first samples are removed beforehand, so that the oldest kept sequence
+// number is recovered from the open block header rather than from fram_buffer. After recovery all samples kept before
+// have to be kept, the interrupted one either kept or lost as a whole, and the buffer has to accept further samples
+static void check_compact_power_loss() {
+    constexpr uint32_t first_kept = 3;
+    constexpr uint32_t pushes = 64;
+    constexpr size_t torn_sizes[] = {0, 1, 4, SIZE_MAX};
+    // fram content with samples pushed without power loss
+    std::vector<uint8_t> image(fram::fram_size);
+    fram::clear();
+    {
+        auto buffer = make_compact_buffer();
+        for (uint32_t i = 0; i <= first_kept; i++) {
+            buffer->push(make_data_point(i));
+        }
+        buffer->remove_until(first_kept - 1);
+    }
+    fram::read_raw(0, image.data(), image.size());
+    for (uint32_t pushed = first_kept + 1; pushed < pushes; pushed++) {
+        for (size_t writes = 0;; writes++) {
+            bool interrupted = false;
+            for (size_t torn : torn_sizes) {
+                fram::write_raw(0, image.data(), image.size());
+                {
+                    auto buffer = make_compact_buffer();
+                    fram::sim::lose_power_after(writes, torn);
+                    buffer->push(make_data_point(pushed));
+                    interrupted = fram::sim::power_lost();
+                    fram::sim::restore_power();
+                }
+                auto buffer = make_compact_buffer();
+                const uint32_t next = buffer->next_sequence();
+                auto samples = read_compact(*buffer);
+                const bool kept = (next == pushed || next == pushed + 1) && samples.size() == next - first_kept &&
+                                  are_pushed_samples(samples, first_kept);
+                buffer->push(make_data_point(next));
+                samples = read_compact(*buffer);
+                if (!kept || samples.size() != next + 1 - first_kept || !are_pushed_samples(samples, first_kept)) {
+                    fprintf(stderr,
+                            "check failed: compact power loss at write %zu (%zu bytes) of push %u\n",
+                            writes,
+                            torn,
+                            pushed);
+                    failed = true;
+                    return;
+                }
+            }
+            if (!interrupted) {
+                break;
+            }
+        }
+        fram::write_raw(0, image.data(), image.size());
+        make_compact_buffer()->push(make_data_point(pushed));
+        fram::read_raw(0, image.data(), image.size());
+    }
+}
+
+int main(int argc, char** argv) {
+    int repetitions = 5;
+    const char* path = FRAM_SIM_PATH;
+    for (int i = 1; i < argc; i++) {
+        if (argv[i] == "--quick"sv) {
+            repetitions = 1;
+        } else if (argv[i] == "--file"sv && i + 1 < argc) {
+            path = argv[++i];
+        } else {
+            fprintf(stderr, "usage: %s [--quick] [--file <path>]\n", argv[0]);
+            return 1;
+        }
+    }
+    fram::sim::open(path);
+
+    printf("fram_buffer<sensors::data_point>: %zu bytes per element, capacity %zu elements\n",
+           sizeof(sensors::data_point),
+           make_buffer()->capacity());
+    printf("%-22s %-10s %8s %12s %10s %10s %12s %12s %10s\n",
+           "operation",
+           "fill",
+           "ops",
+           "host ns/op",
+           "reads/op",
+           "writes/op",
+           "B read/op",
+           "B written/op",
+           "bus ms/op");
+    for (fill_level level : {fill_level::empty, fill_level::half_full, fill_level::wrapped}) {
+        run(level, repetitions);
+    }
+    printf("compact_buffer: %zu samples kept before wrapping\n", compact_wrap_count());
+    for (fill_level level : {fill_level::empty, fill_level::half_full, fill_level::wrapped}) {
+        run_compact(level, repetitions);
+    }
+    check_compact_power_loss();
+
+    fram::sim::close();
+    return failed ? 1 : 0;
+}
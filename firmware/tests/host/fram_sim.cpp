@@ -0,0 +1,104 @@
+#include "fram_sim.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <optional>
+
+namespace fram {
+static uint8_t* mem = nullptr;
+static sim::counters stats{};
+// writes which succeed before power is lost, if power loss is simulated
+static std::optional<size_t> writes_left;
+static size_t torn_write_bytes = 0;
+static bool lost = false;
+
+static void check_range(addr_t addr, size_t size) {
+    if (mem == nullptr || addr + size > fram_size) {
+        fprintf(stderr, "fram: invalid access at 0x%x of %zu bytes\n", addr, size);
+        abort();
+    }
+}
+
+void init() {}
+
+void clear() {
+    check_range(0, fram_size);
+    memset(mem, 0, fram_size);
+}
+
+void write_raw(addr_t addr, const void* data, size_t size) {
+    check_range(addr, size);
+    if (writes_left) {
+        if (*writes_left == 0) {
+            // only the write interrupted by power loss is torn, the following ones don't happen at all
+            if (!lost) {
+                memcpy(mem + addr, data, std::min(size, torn_write_bytes));
+                lost = true;
+            }
+            return;
+        }
+        (*writes_left)--;
+    }
+    memcpy(mem + addr, data, size);
+    stats.writes++;
+    stats.bytes_written += size;
+}
+
+void read_raw(addr_t addr, void* data, size_t size) {
+    check_range(addr, size);
+    memcpy(data, mem + addr, size);
+    stats.reads++;
+    stats.bytes_read += size;
+}
+
+namespace sim {
+double counters::bus_ms() const {
+    // device address and two bytes of memory address, reads send device address again after repeated start
+    constexpr size_t address_bytes = 3;
+    const size_t bytes = bytes_read + bytes_written + reads * (address_bytes + 1) + writes * address_bytes;
+    constexpr double bits_per_byte = 9;
+    constexpr double bus_khz = 400;
+    return bytes * bits_per_byte / bus_khz;
+}
+
+void open(const char* path) {
+    const int fd = ::open(path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0 || ftruncate(fd, fram_size) != 0) {
+        perror(path);
+        exit(1);
+    }
+    void* addr = mmap(nullptr, fram_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (addr == MAP_FAILED) {
+        perror("mmap");
+        exit(1);
+    }
+    mem = static_cast<uint8_t*>(addr);
+}
+
+void close() {
+    munmap(mem, fram_size);
+    mem = nullptr;
+}
+
+counters get_counters() { return stats; }
+
+void reset_counters() { stats = {}; }
+
+void lose_power_after(size_t writes, size_t bytes) {
+    writes_left = writes;
+    torn_write_bytes = bytes;
+    lost = false;
+}
+
+void restore_power() { writes_left.reset(); }
+
+bool power_lost() { return lost; }
+}
+}
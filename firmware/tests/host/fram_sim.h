@@ -0,0 +1,32 @@
+#ifndef ANTENVSENS_HOST_FRAM_SIM_H
+#define ANTENVSENS_HOST_FRAM_SIM_H
+#include "fram.h"
+
+#include <cstddef>
+
+// fram stand-in for host builds, content is kept in a memory mapped file
+namespace fram::sim {
+struct counters {
+    size_t reads;
+    size_t writes;
+    size_t bytes_read;
+    size_t bytes_written;
+
+    // estimated time of transfers on 400 kHz I2C bus, every transaction additionally sends device and memory address
+    double bus_ms() const;
+};
+
+// maps @path as fram content, file is created if it doesn't exist
+void open(const char* path);
+void close();
+counters get_counters();
+void reset_counters();
+// simulates power loss: @writes writes succeed, only the first @bytes of the following one reach fram and all later
+// writes are lost until restore_power()
+void lose_power_after(size_t writes, size_t bytes);
+void restore_power();
+// returns true if a write was lost since lose_power_after()
+bool power_lost();
+}
+
+#endif
@@ -0,0 +1,16 @@
+#ifndef ANTENVSENS_HOST_ZEPHYR_DRIVERS_SENSOR_H
+#define ANTENVSENS_HOST_ZEPHYR_DRIVERS_SENSOR_H
+#include <cstdint>
+
+struct sensor_value {
+    int32_t val1;
+    int32_t val2;
+};
+
+enum sensor_channel {
+    SENSOR_CHAN_AMBIENT_TEMP,
+    SENSOR_CHAN_PRESS,
+    SENSOR_CHAN_HUMIDITY,
+};
+
+#endif
@@ -0,0 +1,20 @@
+#ifndef ANTENVSENS_HOST_ZEPHYR_SYS_CRC_H
+#define ANTENVSENS_HOST_ZEPHYR_SYS_CRC_H
+#include <cstddef>
+#include <cstdint>
+
+// same algorithm as crc32_ieee from Zephyr
+inline uint32_t crc32_ieee_update(uint32_t crc, const uint8_t* data, size_t len) {
+    crc = ~crc;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0xedb88320 & -(crc & 1));
+        }
+    }
+    return ~crc;
+}
+
+inline uint32_t crc32_ieee(const uint8_t* data, size_t len) { return crc32_ieee_update(0, data, len); }
+
+#endif
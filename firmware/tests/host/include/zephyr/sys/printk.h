@@ -0,0 +1,13 @@
+#ifndef ANTENVSENS_HOST_ZEPHYR_SYS_PRINTK_H
+#define ANTENVSENS_HOST_ZEPHYR_SYS_PRINTK_H
+#include <cstdarg>
+#include <cstdio>
+
+__attribute__((format(printf, 1, 2))) inline void printk(const char* fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    vprintf(fmt, args);
+    va_end(args);
+}
+
+#endif
@@ -0,0 +1,155 @@
+#include "line_formatter.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string_view>
+#include <vector>
+
+using namespace std::literals;
+
+constexpr size_t value_count = 5;
+
+struct line {
+    uint32_t sequence;
+    int64_t timestamp_ms;
+    int64_t values[value_count];
+};
+
+// lines of "get data since" output, timestamps are spread over a few years with sub-second periods and gaps
+static std::vector<line> make_lines(size_t count) {
+    std::mt19937_64 rng{1};
+    std::vector<line> lines(count);
+    int64_t timestamp_ms = 1700000000000;
+    for (size_t i = 0; i < count; i++) {
+        timestamp_ms += rng() % 100 == 0 ? rng() % (400LL * 24 * 3600 * 1000) : 250 * (1 + rng() % 8);
+        lines[i].sequence = static_cast<uint32_t>(rng());
+        lines[i].timestamp_ms = timestamp_ms;
+        for (int64_t& value : lines[i].values) {
+            // values around zero check that sign is printed the same way
+            value = rng() % 4 == 0 ? static_cast<int64_t>(rng() % 2000000) - 1000000
+                                   : static_cast<int64_t>(rng() % 200000000000) - 100000000000;
+        }
+    }
+    return lines;
+}
+
+// formats line with the same printk formats which were used before line_formatter, one call per field
+static size_t format_reference(const line& l, char* buf, size_t size) {
+    const time_t seconds = static_cast<time_t>(l.timestamp_ms / 1000);
+    const tm* tm = gmtime(&seconds);
+    int n = snprintf(buf, size, "%u,", l.sequence);
+    n += snprintf(buf + n,
+                  size - n,
+                  "%04d-%02d-%02dT%02d:%02d:%02d",
+                  tm->tm_year + 1900,
+                  tm->tm_mon + 1,
+                  tm->tm_mday,
+                  tm->tm_hour,
+                  tm->tm_min,
+                  tm->tm_sec);
+    if (l.timestamp_ms % 1000 != 0) {
+        n += snprintf(buf + n, size - n, ".%03d", static_cast<int>(l.timestamp_ms % 1000));
+    }
+    for (int64_t value : l.values) {
+        n += snprintf(buf + n, size - n, ",");
+        n += snprintf(buf + n,
+                      size - n,
+                      "%d.%06d",
+                      static_cast<int32_t>(value / 1000000),
+                      static_cast<int32_t>(std::abs(value % 1000000)));
+    }
+    n += snprintf(buf + n, size - n, "\r\n");
+    return n;
+}
+
+static size_t format(line_formatter& formatter, const line& l, char* buf) {
+    formatter.put_unsigned(l.sequence);
+    formatter.put(',');
+    formatter.put_time_ms(l.timestamp_ms);
+    for (int64_t value : l.values) {
+        formatter.put(',');
+        formatter.put_millionths(value);
+    }
+    formatter.end_line();
+    const size_t size = formatter.size();
+    memcpy(buf, formatter.data(), size);
+    formatter.clear();
+    return size;
+}
+
+// returns the fastest of @repetitions runs of @body in nanoseconds per line, @body returns total size of lines
+template <typename F>
+static double measure(size_t lines, int repetitions, F body, size_t& size) {
+    double best_ns = 0;
+    for (int i = 0; i < repetitions; i++) {
+        const auto start = std::chrono::steady_clock::now();
+        size = body();
+        const auto stop = std::chrono::steady_clock::now();
+        const double ns = std::chrono::duration<double, std::nano>(stop - start).count() / lines;
+        best_ns = i == 0 ? ns : std::min(best_ns, ns);
+    }
+    return best_ns;
+}
+
+int main(int argc, char** argv) {
+    int repetitions = 5;
+    size_t count = 200000;
+    for (int i = 1; i < argc; i++) {
+        if (argv[i] == "--quick"sv) {
+            repetitions = 1;
+            count = 20000;
+        } else {
+            fprintf(stderr, "usage: %s [--quick]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    const std::vector<line> lines = make_lines(count);
+    char expected[line_formatter::max_line_size];
+    char actual[line_formatter::max_line_size + 2];
+    line_formatter formatter;
+    for (const line& l : lines) {
+        const size_t expected_size = format_reference(l, expected, sizeof(expected));
+        const size_t actual_size = format(formatter, l, actual);
+        if (std::string_view{expected, expected_size} != std::string_view{actual, actual_size}) {
+            fprintf(stderr,
+                    "mismatch:\n  expected %.*s  actual   %.*s",
+                    static_cast<int>(expected_size),
+                    expected,
+                    static_cast<int>(actual_size),
+                    actual);
+            return 1;
+        }
+    }
+
+    size_t reference_size = 0;
+    const double reference_ns = measure(count, repetitions, [&] {
+        size_t total = 0;
+        for (const line& l : lines) {
+            total += format_reference(l, expected, sizeof(expected));
+        }
+        return total;
+    }, reference_size);
+    size_t formatter_size = 0;
+    const double formatter_ns = measure(count, repetitions, [&] {
+        line_formatter f;
+        size_t total = 0;
+        for (const line& l : lines) {
+            total += format(f, l, actual);
+        }
+        return total;
+    }, formatter_size);
+
+    printf("%zu lines, %.1f bytes per line, output of both formatters is identical\n",
+           count,
+           static_cast<double>(formatter_size) / count);
+    printf("%-16s %12s\n", "formatter", "ns/line");
+    printf("%-16s %12.1f\n", "printk formats", reference_ns);
+    printf("%-16s %12.1f\n", "line_formatter", formatter_ns);
+    printf("speedup: %.1fx\n", reference_ns / formatter_ns);
+    return reference_size == formatter_size ? 0 : 1;
+}
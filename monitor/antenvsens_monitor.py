@@ -1,16 +1,48 @@
+from concurrent.futures import ThreadPoolExecutor
 from dataclasses import dataclass
-from datetime import datetime
+from datetime import datetime, timezone
 from typing import Callable
 
 import os
 import serial
+import struct
+import zlib
 import argparse
+import calendar
+import signal
 import subprocess
+import sys
+import threading
+import time
 
 baudrate = 115200
 timeout = 3
+# time it takes sensor to switch its baud rate after confirming the command
+baud_switch_delay = 0.05
 verbose = False
 
+ack_prompt = b'remove printed data from the device? (y/N): '
+end_of_data = b'end of data\r\n'
+end_of_stats = b'end of stats\r\n'
+
+# binary frame: sync byte, payload length, payload, crc32 of payload, empty payload marks end of transfer
+frame_sync = 0xae
+# names of values of entries, sensors which don't report their schema store these
+default_schema = ("bme_temperature", "bme_pressure", "bme_humidity", "sht_temperature", "sht_humidity")
+
+# sequence number followed by sensors::data_point: timestamp in milliseconds followed by val1 and val2 of every value
+def data_frame_format(schema: tuple[str, ...]) -> struct.Struct:
+    return struct.Struct(f"<Iq{2 * len(schema)}i")
+
+output_formats = ['text', 'csv', 'binary']
+
+def csv_header(schema: tuple[str, ...]) -> str:
+    return ",".join(("timestamp",) + schema) + "\n"
+
+# binary output record: timestamp in milliseconds since epoch followed by values in millionths, in the order of schema
+def binary_record_format(schema: tuple[str, ...]) -> struct.Struct:
+    return struct.Struct(f"<q{len(schema)}q")
+
 def log_verbose(msg: str):
     if verbose:
         print(msg)
@@ -20,15 +52,76 @@ class Sensor:
     port: str
     name: str
     serial: serial.Serial
-
-
+    # names of values of entries
+    schema: tuple[str, ...] = default_schema
+    # time.monotonic() time after which the current operation on sensor is given up
+    deadline: float | None = None
+
+# error which makes an operation on a single sensor fail, without affecting other sensors
+class SensorError(Exception):
+    pass
+
+# raises SensorError if deadline of the current operation on @sensor passed, otherwise shortens timeout of the next
+# read so that it doesn't end after the deadline
+def check_deadline(sensor: Sensor):
+    if sensor.deadline is None:
+        return
+    remaining = sensor.deadline - time.monotonic()
+    if remaining <= 0:
+        raise SensorError("deadline exceeded")
+    if remaining < timeout or sensor.serial.timeout != timeout:
+        sensor.serial.timeout = min(remaining, timeout)
+
+# Sensors are handled concurrently, each one by its own worker thread, so that a slow or unresponsive sensor doesn't
+# delay the other ones and the time of an operation is set by the slowest sensor. Every sensor gets its own deadline
+# of @operation_timeout seconds (if given). Errors are reported for every sensor after all of them finish, returns
+# true if the operation succeeded on all sensors
+def for_each_sensor(description: str, action: Callable[[Sensor], None], operation_timeout: float | None) -> bool:
+    def run(sensor: Sensor) -> str | None:
+        sensor.deadline = time.monotonic() + operation_timeout if operation_timeout else None
+        try:
+            action(sensor)
+            return None
+        except SensorError as e:
+            return str(e)
+        except serial.SerialException:
+            return "serial exception"
+        finally:
+            sensor.deadline = None
+            sensor.serial.timeout = timeout
+
+    if len(devices) == 0:
+        return True
+    with ThreadPoolExecutor(max_workers=len(devices)) as executor:
+        errors = list(executor.map(run, devices))
+    failed = [(sensor, error) for sensor, error in zip(devices, errors) if error is not None]
+    for sensor, error in failed:
+        print(f"{description} failed on {sensor.name}: {error}")
+    log_verbose(f"{description} succeeded on {len(devices) - len(failed)} of {len(devices)} sensors")
+    return len(failed) == 0
+
+
+# values which aren't in schema of the sensor are None
 @dataclass
 class EnvironmentalData:
-    bme_temp: float
-    bme_pressure: float
-    bme_humidity: float
-    sht_temp: float
-    sht_humidity: float
+    bme_temp: str | None = None
+    bme_pressure: str | None = None
+    bme_humidity: str | None = None
+    sht_temp: str | None = None
+    sht_humidity: str | None = None
+
+    @classmethod
+    def from_values(cls, schema: tuple[str, ...], values: list[str]) -> "EnvironmentalData":
+        return cls(**{environmental_data_fields[name]: value for name, value in zip(schema, values) if name in environmental_data_fields})
+
+# maps names of values in schema to fields of EnvironmentalData
+environmental_data_fields = {
+    "bme_temperature": "bme_temp",
+    "bme_pressure": "bme_pressure",
+    "bme_humidity": "bme_humidity",
+    "sht_temperature": "sht_temp",
+    "sht_humidity": "sht_humidity",
+}
 
 class DevInfo:
     FTDI_VENDOR_ID = '0403'
@@ -86,159 +179,555 @@ def list_candidates():
                     candidates.append(fp)
     return candidates
 
+# reads names of values of entries, firmware without "get schema" command stores the default ones
+def read_schema(ser: serial.Serial) -> tuple[str, ...]:
+    command = b"get schema"
+    ser.write(command + b"\n")
+    echo = ser.readline()
+    if echo != command + b"\r\n":
+        log_verbose("schema command echo missing")
+    line = ser.readline().decode("utf-8", errors="replace").strip()
+    if line == "" or line == "invalid command":
+        return default_schema
+    return tuple(line.split(","))
+
+# opens @candidate and reads name and schema of the board connected to it, returns nothing if there is no board
+def probe_device(candidate: str) -> tuple[serial.Serial, str, tuple[str, ...]] | None:
+    try:
+        ser = serial.Serial(candidate, baudrate=baudrate, timeout=timeout, exclusive=True)
+        ser.write(b"\r\n") # if script was previously killed board may still be waiting for data removal confirmation
+        ser.readline()
+        ser.write(b"get name\n")
+        line = ser.readline()
+
+        if line == b'': # there is no board on this tty
+            ser.close()
+            return None
+
+        line = ser.readline()
+        name = line.decode("utf-8").replace("\r\n", "").strip()
+        return ser, name, read_schema(ser)
+    except serial.SerialException:
+        print(f"serial exception on {candidate}")
+        return None
+
 def scan_devices(allow_invalid_names: bool):
     print("Scanning devices...")
 
-    for candidate in list_candidates():
-        try:
-            ser = serial.Serial(candidate, baudrate=baudrate, timeout=timeout, exclusive=True)
-            ser.write(b"\r\n") # if script was previously killed board may still be waiting for data removal confirmation
-            ser.readline()
-            ser.write(b"get name\n")
-            line = ser.readline()
-
-            if line == b'': # there is no board on this tty
-                ser.close()
+    # candidates are probed concurrently, but names are checked in order of candidates, so duplicates are resolved
+    # the same way regardless of response times
+    candidates = list_candidates()
+    with ThreadPoolExecutor(max_workers=max(len(candidates), 1)) as executor:
+        probed = list(executor.map(probe_device, candidates))
+
+    for candidate, result in zip(candidates, probed):
+        if result is None:
+            continue
+        ser, name, schema = result
+
+        if not allow_invalid_names:
+            duplicate, port = is_duplicate(name)
+            if name == '':
+                print(f"{candidate}: Name cannot be empty")
+                continue
+            if duplicate:
+                print(f"{candidate}: Duplicated name ('{name}' already exists on {port})")
                 continue
 
-            line = ser.readline()
-            name = line.decode("utf-8").replace("\r\n", "").strip()
-
-            if not allow_invalid_names:
-                duplicate, port = is_duplicate(name)
-                if name == '':
-                    print(f"{candidate}: Name cannot be empty")
-                    continue
-                if duplicate:
-                    print(f"{candidate}: Duplicated name ('{name}' already exists on {port})")
-                    continue
-
-            else:
-                name = candidate.replace("/", "\\") + "\\" + name
-
-            print(f"{name} found on {candidate}")
-
-            devices.append(Sensor(candidate, name, ser))
-        except serial.SerialException:
-            print(f"serial exception on {candidate}")
-
-def set_time():
-    for sensor in devices:
+        else:
+            name = candidate.replace("/", "\\") + "\\" + name
+
+        print(f"{name} found on {candidate}")
+
+        if schema != default_schema:
+            log_verbose(f"{name} stores {','.join(schema)}")
+        devices.append(Sensor(candidate, name, ser, schema))
+
+def set_time(operation_timeout: float | None) -> bool:
+    def set_sensor_time(sensor: Sensor):
+        command = b"set time " + datetime.now().isoformat(timespec="seconds").encode()
+        sensor.serial.write(command + b"\n")
+        log_verbose(f"setting {sensor.name} time")
+        check_deadline(sensor)
+        echo = sensor.serial.readline()
+        if echo != command + b"\r\n":
+            log_verbose(f"time command echo missing")
+        check_deadline(sensor)
+        if sensor.serial.readline() != b"time set\r\n": # confirmation
+            raise SensorError("response missing")
+
+    return for_each_sensor("setting time", set_sensor_time, operation_timeout)
+
+# formats sensor_value the same way as the firmware does
+def format_sensor_value(val1: int, val2: int) -> str:
+    val = val1 * 1000000 + val2
+    integer_part = abs(val) // 1000000 * (-1 if val < 0 else 1)
+    decimal_part = abs(val) % 1000000
+    return f"{integer_part}.{decimal_part:06d}"
+
+# formats value given in millionths with its sign, unlike the firmware which leaves out sign of values between -1 and 0
+def format_millionths(value: int) -> str:
+    return f"{'-' if value < 0 else ''}{abs(value) // 1000000}.{abs(value) % 1000000:06d}"
+
+# data point read from sensor: timestamp in milliseconds since epoch and values in millionths
+DataPoint = tuple[int, list[int]]
+# entry read from sensor: sequence number (if it was requested) and data point
+Entry = tuple[int | None, DataPoint]
+# formats text fields of data point with given schema as line of text output
+TextFormatter = Callable[[tuple[str, ...], list[str]], str]
+
+# milliseconds are printed only if timestamp isn't a whole second, the same way as the firmware does
+def format_timestamp_ms(timestamp_ms: int) -> str:
+    time_str = datetime.fromtimestamp(timestamp_ms // 1000, timezone.utc).strftime("%Y-%m-%dT%H:%M:%S")
+    if timestamp_ms % 1000 != 0:
+        time_str += f".{timestamp_ms % 1000:03d}"
+    return time_str
+
+def decode_data_frame(frame_format: struct.Struct, payload: bytes) -> Entry:
+    sequence, timestamp_ms, *values = frame_format.unpack(payload)
+    return sequence, (timestamp_ms, [values[i] * 1000000 + values[i + 1] for i in range(0, len(values), 2)])
+
+# inverse of format_sensor_value, returns value in millionths
+def parse_sensor_value(val: str) -> int:
+    integer_part, decimal_part = val.lstrip("-").split(".")
+    millionths = int(integer_part) * 1000000 + int(decimal_part.ljust(6, "0")[:6])
+    return -millionths if val.startswith("-") else millionths
+
+# inverse of time formatting in decode_data_frame, returns milliseconds since epoch
+def parse_timestamp_ms(time_str: str) -> int:
+    seconds = calendar.timegm(datetime.strptime(time_str[:19], "%Y-%m-%dT%H:%M:%S").timetuple())
+    return seconds * 1000 + (int(time_str[20:23]) if len(time_str) > 19 else 0)
+
+# parses text fields of data point printed by the firmware, returns nothing if they are malformed
+def parse_text_fields(fields: list[str]) -> DataPoint | None:
+    try:
+        return parse_timestamp_ms(fields[0]), [parse_sensor_value(field) for field in fields[1:]]
+    except (IndexError, ValueError):
+        return None
+
+# text fields of data point formatted the same way as the firmware does
+def firmware_fields(point: DataPoint) -> list[str]:
+    timestamp_ms, values = point
+    return [format_timestamp_ms(timestamp_ms)] + [format_sensor_value(0, value) for value in values]
+
+# text fields of data point with exact values
+def exact_fields(point: DataPoint) -> list[str]:
+    timestamp_ms, values = point
+    return [format_timestamp_ms(timestamp_ms)] + [format_millionths(value) for value in values]
+
+# Output file of a single sensor, kept open for the whole transfer, so entries are written through one buffered handle
+# as they arrive. The file is opened with the first entry, so transfers without entries don't create it. Entries of a
+# transfer which has to be read again can be discarded
+class OutputFile:
+    def __init__(self, filename: str, format: str, format_text: TextFormatter, schema: tuple[str, ...]):
+        self.filename = filename
+        self.format = format
+        self.schema = schema
+        self.record_format = binary_record_format(schema)
+        self.format_text = format_text
+        self.file = None
+        self.start = 0
+        self.count = 0
+
+    # writes data point, returns false if it doesn't match schema. Text output is formatted the same way as by the
+    # firmware, csv and binary outputs keep exact values
+    def write(self, point: DataPoint) -> bool:
+        if len(point[1]) != len(self.schema):
+            return False
         try:
-            command = b"set time " + datetime.now().isoformat(timespec="seconds").encode()
-            sensor.serial.write(command + b"\n")
-            log_verbose(f"setting {sensor.name} time")
-            echo = sensor.serial.readline()
-            if echo != command + b"\r\n":
-                log_verbose(f"time command echo missing")
-            if sensor.serial.readline() != b"time set\r\n": # confirmation
-                log_verbose("response missing")
-        except serial.SerialException:
-            print(f"serial exception on {sensor.name}")
+            if self.format == 'text':
+                record = self.format_text(self.schema, firmware_fields(point)).encode()
+            elif self.format == 'csv':
+                record = (",".join(exact_fields(point)) + "\n").encode()
+            else:
+                record = self.record_format.pack(point[0], *point[1])
+        except (TypeError, ValueError, OverflowError, struct.error):
+            return False
+        if self.file is None:
+            self.file = open(self.filename, "ab", buffering=1 << 16)
+            self.start = self.file.tell()
+            if self.format == 'csv' and self.start == 0:
+                self.file.write(csv_header(self.schema).encode())
+        self.file.write(record)
+        self.count += 1
+        return True
+
+    # removes entries written since opening the file
+    def discard(self):
+        if self.file:
+            self.file.flush()
+            self.file.truncate(self.start)
+        self.count = 0
+
+    # makes written entries visible to readers of the file
+    def flush(self):
+        if self.file:
+            self.file.flush()
+
+    def close(self):
+        if self.file:
+            self.file.close()
+
+# returns true if deadline of the current operation on @sensor passed, transfers are then interrupted keeping entries
+# read so far
+def deadline_passed(sensor: Sensor) -> bool:
+    try:
+        check_deadline(sensor)
+        return False
+    except SensorError:
+        log_verbose(f"deadline of {sensor.name} passed during transfer")
+        return True
+
+# reads lines until @terminator passing entries to @on_entry as they arrive, returns sequence number of the last entry
+# accepted by @on_entry (if entries are sequenced) and whether terminator was found; reading of sequenced entries stops
+# at the first one which isn't accepted, so that entries after it aren't acknowledged
+def read_text_data(sensor: Sensor, terminator: bytes, sequenced: bool, on_entry: Callable[[DataPoint], bool]) -> tuple[int | None, bool]:
+    ser = sensor.serial
+    last_sequence = None
+    line = None
+    while line != b'':
+        if deadline_passed(sensor):
+            return last_sequence, False
+        line = ser.readline()
+        if line == terminator:
+            return last_sequence, True
+        fields = line.decode().replace("\r\n", "").split(",")
+        if sequenced:
+            try:
+                sequence = int(fields[0])
+            except ValueError:
+                continue
+            point = parse_text_fields(fields[1:])
+            if point is None or not on_entry(point):
+                log_verbose(f"malformed entry {sequence}")
+                return last_sequence, False
+            last_sequence = sequence
+        elif (point := parse_text_fields(fields)) is not None:
+            on_entry(point)
+    return last_sequence, False
+
+# reads frames until the end frame and then @terminator passing entries to @on_entry as they arrive, returns sequence
+# number of the last entry accepted by @on_entry and whether terminator was found; reading stops at the first entry
+# which isn't accepted
+def read_binary_data(sensor: Sensor, terminator: bytes, on_entry: Callable[[DataPoint], bool]) -> tuple[int | None, bool]:
+    ser = sensor.serial
+    frame_format = data_frame_format(sensor.schema)
+    last_sequence = None
+    while True:
+        if deadline_passed(sensor):
+            return last_sequence, False
+        sync = ser.read(1)
+        if sync == b'':
+            return last_sequence, False
+        if sync[0] != frame_sync:
+            continue
+        size = ser.read(1)
+        if size == b'':
+            return last_sequence, False
+        payload = ser.read(size[0])
+        crc = ser.read(4)
+        if len(payload) != size[0] or len(crc) != 4:
+            return last_sequence, False
+        if zlib.crc32(payload) != int.from_bytes(crc, "little"):
+            log_verbose("frame crc mismatch")
+            continue
+        if size[0] == 0:
+            break
+        if size[0] != frame_format.size:
+            log_verbose(f"unexpected frame size {size[0]}")
+            continue
+        sequence, point = decode_data_frame(frame_format, payload)
+        if not on_entry(point):
+            log_verbose(f"malformed entry {sequence}")
+            return last_sequence, False
+        last_sequence = sequence
+    return last_sequence, ser.read(len(terminator)) == terminator
+
+def output_filename(output_path: str, sensor: Sensor, format: str) -> str:
+    extensions = {'text': '', 'csv': '.csv', 'binary': '.bin'}
+    return f"{output_path}/{sensor.name.replace(' ', '-')}{extensions[format]}"
+
+# incremental reads store sequence number of the first entry which wasn't read yet in this file
+def sequence_filename(output_path: str, sensor: Sensor) -> str:
+    return f"{output_path}/.{sensor.name.replace(' ', '-')}.sequence"
+
+def read_next_sequence(filename: str) -> int:
+    try:
+        with open(filename, encoding="utf-8") as f:
+            return int(f.read())
+    except (OSError, ValueError):
+        return 0
+
+# switches baud rate of sensor and serial port, the sensor keeps the new rate only after receiving ping with it,
+# otherwise both go back to the previous rate, returns whether the rate was switched
+def switch_baudrate(sensor: Sensor, rate: int) -> bool:
+    command = f"set baud {rate}".encode()
+    sensor.serial.write(command + b"\n")
+    echo = sensor.serial.readline()
+    if echo != command + b"\r\n":
+        log_verbose("baud command echo missing")
+    if sensor.serial.readline() != b"switching baud\r\n":
+        log_verbose(f"{sensor.name} refused baud rate {rate}")
+        return False
 
-def get_data(output_path: str, temp_str_gen: Callable[[EnvironmentalData], str], hum_str_gen: Callable[[EnvironmentalData], str], press: bool, separator: str):
+    previous_rate = sensor.serial.baudrate
+    time.sleep(baud_switch_delay)
+    sensor.serial.baudrate = rate
+    sensor.serial.reset_input_buffer()
+    sensor.serial.write(b"ping\n")
+    # echo of ping may be preceded by bytes garbled by switching
+    for _ in range(3):
+        line = sensor.serial.readline()
+        if line == b"pong\r\n":
+            log_verbose(f"switched {sensor.name} to {rate} baud")
+            return True
+        if line == b"":
+            break
+
+    log_verbose(f"switching {sensor.name} to {rate} baud failed")
+    sensor.serial.baudrate = previous_rate
+    # sensor restores the previous rate after not receiving ping in time
+    time.sleep(timeout)
+    sensor.serial.reset_input_buffer()
+    return False
+
+# reads data from a single sensor and saves it to its output file as it arrives
+def get_sensor_data(sensor: Sensor, output_path: str, format: str, format_text: TextFormatter, binary: bool, incremental: bool, bulk_baudrate: int | None):
+    filename = output_filename(output_path, sensor, format)
+    switched = False
+    output = None
+    try:
+        if bulk_baudrate and bulk_baudrate != baudrate:
+            switched = switch_baudrate(sensor, bulk_baudrate)
+        if incremental:
+            next_sequence = read_next_sequence(sequence_filename(output_path, sensor))
+            command = f"get data since {next_sequence}".encode()
+            terminator = b'' if binary else end_of_data
+        else:
+            command = b"get data"
+            terminator = ack_prompt
+        if binary:
+            command += b" binary"
+        output = OutputFile(filename, format, format_text, sensor.schema)
+        sensor.serial.write(command + b"\n")
+        log_verbose(f"reading from {sensor.name}")
+        check_deadline(sensor)
+        line = sensor.serial.readline()
+        if line != command + b"\r\n":
+            log_verbose(f"read command echo missing")
+
+        if binary:
+            last_sequence, complete = read_binary_data(sensor, terminator, output.write)
+        else:
+            last_sequence, complete = read_text_data(sensor, terminator, incremental, output.write)
+
+        # entries read incrementally are sequenced, so they can be saved even if transfer was interrupted, otherwise
+        # they are read again by the next run
+        if not complete and not incremental:
+            output.discard()
+            raise SensorError("confirmation dialog missing")
+
+        log_verbose(f"{output.count} entries have been written to {filename}")
+        output.close()
+
+        if incremental:
+            if last_sequence is not None:
+                with open(sequence_filename(output_path, sensor), "w", encoding="utf-8") as f:
+                    f.write(f"{last_sequence + 1}")
+                command = f"ack {last_sequence}".encode()
+                sensor.serial.write(command + b"\n")
+                log_verbose(f"sent acknowledge of entries up to {last_sequence}")
+                echo = sensor.serial.readline()
+                if echo != command + b"\r\n":
+                    log_verbose("acknowledge echo missing")
+                if sensor.serial.readline() != b"acknowledged\r\n":
+                    log_verbose("response missing")
+            if not complete:
+                raise SensorError(f"transfer interrupted after {output.count} entries")
+            return
+
+        sensor.serial.write(b"y\n")
+        log_verbose(f"sent confirmation")
+        echo = sensor.serial.readline()
+        if echo != b"y\r\n":
+            log_verbose("confirmation echo missing")
+    finally:
+        if output:
+            output.close()
+        if switched:
+            # switching back isn't limited by the deadline, otherwise sensor would stay at the switched rate
+            sensor.serial.timeout = timeout
+            try:
+                switch_baudrate(sensor, baudrate)
+            except serial.SerialException:
+                log_verbose(f"serial exception on {sensor.name}")
+
+# returns function formatting line of text output with selected sources from text fields of data point with given
+# schema, every field is followed by separator, sources missing from schema are left out
+def text_formatter(temp_str_gen: Callable[[EnvironmentalData], str], hum_str_gen: Callable[[EnvironmentalData], str], press: bool, separator: str) -> TextFormatter:
+    def format_text(schema: tuple[str, ...], fields: list[str]) -> str:
+        env_data = EnvironmentalData.from_values(schema, fields[1:])
+        line = f"{fields[0]}{separator}"
+        if temp_str_gen and (text := temp_str_gen(env_data)):
+            line += text + separator
+        if hum_str_gen and (text := hum_str_gen(env_data)):
+            line += text + separator
+        if press and env_data.bme_pressure is not None:
+            line += f"Pressure={env_data.bme_pressure}{separator}"
+        return line + "\n"
+    return format_text
+
+def get_data(output_path: str, format: str, format_text: TextFormatter, binary: bool, incremental: bool, bulk_baudrate: int | None, operation_timeout: float | None) -> bool:
     if len(devices) > 0:
         os.makedirs(output_path, exist_ok=True)
 
-    for sensor in devices:
-
+    return for_each_sensor(
+        "reading data",
+        lambda sensor: get_sensor_data(sensor, output_path, format, format_text, binary, incremental, bulk_baudrate),
+        operation_timeout
+    )
+
+# parses streamed line "@<sequence>,<timestamp in ms>,<values in millionths>", returns sequence number and data point
+# with exact values
+def parse_stream_line(line: bytes) -> Entry | None:
+    try:
+        sequence, timestamp_ms, *values = map(int, line[1:].decode().rstrip().split(","))
+    except ValueError:
+        return None
+    return sequence, (timestamp_ms, values)
+
+# Streams measurements from sensors as soon as they are stored until interrupted with Ctrl+C, appending them to output
+# files (flushed after every entry) and printing them. Stream is turned off before returning. Measurements which sensor
+# couldn't write to the stream on time are reported as missing and can be read with --get
+def follow(output_path: str, format: str, format_text: TextFormatter) -> bool:
+    stop = threading.Event()
+
+    def follow_sensor(sensor: Sensor):
+        output = OutputFile(output_filename(output_path, sensor, format), format, format_text, sensor.schema)
+        sensor.serial.write(b"stream on\n")
+        echo = sensor.serial.readline()
+        if echo != b"stream on\r\n":
+            log_verbose("stream command echo missing")
+        if sensor.serial.readline() != b"stream on\r\n":
+            raise SensorError("response missing")
+        log_verbose(f"following {sensor.name}")
         try:
-            data: list[bytes] = []
-
-            command = b"get data"
-            sensor.serial.write(command + b"\n")
-            log_verbose(f"reading from {sensor.name}")
-            line = sensor.serial.readline()
-            if line != command + b"\r\n":
-                log_verbose(f"read command echo missing")
-
-            ack = False
-            while line != b'':
+            last_sequence = None
+            # line which was only partially received before timeout
+            pending = b''
+            while not stop.is_set():
+                line = pending + sensor.serial.readline()
+                if not line.endswith(b"\n"):
+                    pending = line
+                    continue
+                pending = b''
+                entry = parse_stream_line(line) if line.startswith(b"@") else None
+                if entry is None:
+                    continue
+                sequence, point = entry
+                if last_sequence is not None and sequence - last_sequence > 1:
+                    print(f"{sensor.name}: {sequence - last_sequence - 1} entries missing from stream")
+                last_sequence = sequence
+                if output.write(point):
+                    output.flush()
+                    print(f"{sensor.name}: {','.join(exact_fields(point))}")
+        finally:
+            output.close()
+            sensor.serial.write(b"stream off\n")
+            # streamed lines may precede the response
+            for _ in range(16):
                 line = sensor.serial.readline()
-                if line == b'remove printed data from the device? (y/N): ':
-                    ack = True
+                if line == b"stream off\r\n" or line == b'':
                     break
-                data.append(line)
-
-            log_verbose(f"read {len(data)} entries")
-
-            if not ack:
-                log_verbose("confirmation dialog missing")
-                continue
 
-            filename = f"{output_path}/{sensor.name.replace(' ', '-')}"
-            write_count = 0
-            for entry in data:
-
-                entry = entry.decode().replace("\r\n", "").split(",")
-                try:
-                    time_date = entry[0]
-                    env_data = EnvironmentalData(*entry[1:])
-
-                    
-                    with open(filename , "a", encoding="utf-8") as f:
-                        write_field = lambda field : f.write(field+separator)
-
-                        write_field(f"{time_date}")
-                        if temp_str_gen:
-                            write_field(temp_str_gen(env_data))
-                        if hum_str_gen:
-                            write_field(hum_str_gen(env_data))
-                        if press:
-                            write_field(f"Pressure={env_data.bme_pressure}")
-                        f.write("\n")
-                        write_count += 1
-                finally:
-                    continue
-
-            log_verbose(f"{write_count} entries have been written to {filename}")
+    if len(devices) > 0:
+        os.makedirs(output_path, exist_ok=True)
+    previous_handler = signal.signal(signal.SIGINT, lambda signum, frame: stop.set())
+    try:
+        return for_each_sensor("following", follow_sensor, None)
+    finally:
+        signal.signal(signal.SIGINT, previous_handler)
+
+def set_period(period: float, operation_timeout: float | None) -> bool:
+    def set_sensor_period(sensor: Sensor):
+        command = b"set period " + f"{period:.3f}".rstrip("0").rstrip(".").encode()
+        sensor.serial.write(command + b"\n")
+        log_verbose(f"setting {sensor.name} period")
+        check_deadline(sensor)
+        echo = sensor.serial.readline()
+        if echo != command + b"\r\n":
+            log_verbose(f"period command echo missing")
+        check_deadline(sensor)
+        if sensor.serial.readline() != b"period set\r\n": # confirmation
+            raise SensorError("response missing")
+
+    return for_each_sensor("setting period", set_sensor_period, operation_timeout)
+
+# appends statistics collected by sensors since the previous scrape to <name>.stats files, every line is prefixed with
+# time of the scrape
+def get_stats(output_path: str, operation_timeout: float | None) -> bool:
+    def get_sensor_stats(sensor: Sensor):
+        command = b"get stats reset"
+        sensor.serial.write(command + b"\n")
+        log_verbose(f"getting {sensor.name} stats")
+        check_deadline(sensor)
+        echo = sensor.serial.readline()
+        if echo != command + b"\r\n":
+            log_verbose(f"stats command echo missing")
+        scrape_time = datetime.now().isoformat(timespec="seconds")
+        lines = []
+        while True:
+            check_deadline(sensor)
+            line = sensor.serial.readline()
+            if line == end_of_stats:
+                break
+            if not line.endswith(b"\n"):
+                raise SensorError("timeout while reading stats")
+            lines.append(f"{scrape_time} {line.decode(errors='replace').rstrip()}\n")
+        with open(os.path.join(output_path, f"{sensor.name}.stats"), "a") as file:
+            file.writelines(lines)
 
-            sensor.serial.write(b"y\n")
-            log_verbose(f"sent confirmation")
-            echo = sensor.serial.readline()
-            if echo != b"y\r\n":
-                log_verbose("confirmation echo missing")
+    return for_each_sensor("getting stats", get_sensor_stats, operation_timeout)
 
-        except serial.SerialException:
-            log_verbose(f"serial exception on {sensor.name}")
+# formats "<name>=<value>" pairs separated with spaces leaving out values missing from schema of the sensor
+def format_values(**values: str | None) -> str:
+    return " ".join(f"{name}={value}" for name, value in values.items() if value is not None)
 
-def set_period(period: int):
-    for sensor in devices:
-        try:
-            command = b"set period " + f"{period}".encode()
-            sensor.serial.write(command + b"\n")
-            log_verbose(f"setting {sensor.name} period")
-            echo = sensor.serial.readline()
-            if echo != command + b"\r\n":
-                log_verbose(f"period command echo missing")
-            if sensor.serial.readline() != b"period set\r\n": # confirmation
-                log_verbose("response missing")
-        except serial.SerialException:
-            print(f"serial exception on {sensor.name}")
+# averages values present in schema of the sensor, is empty if none of them is
+def format_average(name: str, *values: str | None) -> str:
+    present = [float(value) for value in values if value is not None]
+    return f"{name}={sum(present) / len(present)}" if present else ""
 
 temp_str_gens = {
-    'both': (lambda env_data : f"Temperature_BME={env_data.bme_temp} Temperature_SHT={env_data.sht_temp}"),
-    'sht': (lambda env_data : f"Temperature={env_data.sht_temp}"),
-    'bme': (lambda env_data : f"Temperature={env_data.bme_temp}"),
-    'avg': (lambda env_data : f"Temperature={(float(env_data.bme_temp) + float(env_data.sht_temp)) / 2}")
+    'both': (lambda env_data : format_values(Temperature_BME=env_data.bme_temp, Temperature_SHT=env_data.sht_temp)),
+    'sht': (lambda env_data : format_values(Temperature=env_data.sht_temp)),
+    'bme': (lambda env_data : format_values(Temperature=env_data.bme_temp)),
+    'avg': (lambda env_data : format_average("Temperature", env_data.bme_temp, env_data.sht_temp))
 } 
 
 hum_str_gens = {
-    'both': (lambda env_data : f"Relative_Humidity_BME={env_data.bme_humidity} Relative_Humidity_SHT={env_data.sht_humidity}"),
-    'sht': (lambda env_data : f"Relative_Humidity={env_data.sht_humidity}"),
-    'bme': (lambda env_data : f"Relative_Humidity={env_data.bme_humidity}"),
-    'avg': (lambda env_data : f"Relative_Humidity={(float(env_data.bme_humidity) + float(env_data.sht_humidity)) / 2}")
+    'both': (lambda env_data : format_values(Relative_Humidity_BME=env_data.bme_humidity, Relative_Humidity_SHT=env_data.sht_humidity)),
+    'sht': (lambda env_data : format_values(Relative_Humidity=env_data.sht_humidity)),
+    'bme': (lambda env_data : format_values(Relative_Humidity=env_data.bme_humidity)),
+    'avg': (lambda env_data : format_average("Relative_Humidity", env_data.bme_humidity, env_data.sht_humidity))
 } 
 
 parser = argparse.ArgumentParser(prog="Sensor monitor")
-parser.add_argument("-p", "--period", action="store", type=int, help="set time between consecutive measurements in seconds")
+parser.add_argument("-p", "--period", action="store", type=float, help="set time between consecutive measurements in seconds, with millisecond resolution")
 parser.add_argument("-g", "--get", action="store_true", help="read data from sensors and save it to log files")
 parser.add_argument("-t", "--time", action="store_true", help="set sensors time to curent date")
 parser.add_argument("-ts", "--temperature-source", action="store", type=str, default='avg', choices=['none', 'both', 'avg', 'bme', 'sht'], help="select temperatue source")
 parser.add_argument("-hs", "--humidity-source", action="store", type=str, default='avg', choices=['none', 'both', 'avg', 'bme', 'sht'], help="select humidity source")
 parser.add_argument("-ps", "--pressure-source", action="store", type=str, default='bme', choices=['none', 'bme'], help="select pressure source")
 parser.add_argument("-fs", "--field-separator", action="store", type=str, default=' ', help="set field separator in log files")
+parser.add_argument("-i", "--incremental", action="store_true", help="read only data which wasn't read before, resuming interrupted transfers")
+parser.add_argument("-b", "--binary", action="store_true", help="transfer data from sensors as binary frames")
+parser.add_argument("-B", "--baudrate", action="store", type=int, help="switch sensors to given baud rate while reading data")
+parser.add_argument("-f", "--format", action="store", type=str, default='text', choices=output_formats, help="select format of log files")
+parser.add_argument("-F", "--follow", action="store_true", help="stream measurements from sensors as soon as they are stored, until interrupted with Ctrl+C")
+parser.add_argument("-s", "--stats", action="store_true", help="append runtime statistics of sensors to <name>.stats files and reset them")
 parser.add_argument("-o", "--output-path", action="store", type=str, default='.', help="set log files output path")
+parser.add_argument("-d", "--deadline", action="store", type=float, help="give up on a sensor if an operation on it doesn't finish within given number of seconds")
 parser.add_argument("--allow-invalid-names", action="store_true", help="allow invalid sensor names by prepending them with serial port name")
 parser.add_argument("-v", "--verbose", action="store_true", help="enable verbose output")
 
@@ -247,29 +736,48 @@ def main():
     global verbose
     verbose = args.verbose
 
-    if not args.period and not args.get and not args.time:
+    if not args.period and not args.get and not args.time and not args.stats and not args.follow:
         parser.print_usage()
-        return
+        return 0
 
     scan_devices(args.allow_invalid_names)
 
+    succeeded = True
     if args.period:
-        set_period(args.period)
+        succeeded &= set_period(args.period, args.deadline)
 
     if args.time:
-        set_time()
+        succeeded &= set_time(args.deadline)
+
+    format_text = text_formatter(
+        temp_str_gens.get(args.temperature_source),
+        hum_str_gens.get(args.humidity_source),
+        args.pressure_source != 'none',
+        args.field_separator
+    )
 
     if args.get:
-        get_data(
+        succeeded &= get_data(
             args.output_path,
-            temp_str_gens.get(args.temperature_source),
-            hum_str_gens.get(args.humidity_source),
-            args.pressure_source != 'none',
-            args.field_separator
+            args.format,
+            format_text,
+            args.binary,
+            args.incremental,
+            args.baudrate,
+            args.deadline
         )
 
+    if args.stats:
+        succeeded &= get_stats(args.output_path, args.deadline)
+
+    if args.follow:
+        succeeded &= follow(args.output_path, args.format, format_text)
+
     for sensor in devices:
         sensor.serial.close()
 
+    # non-zero exit status tells scripts that some sensors have to be retried
+    return 0 if succeeded else 1
+
 if __name__ == "__main__":
-    main()
+    sys.exit(main())
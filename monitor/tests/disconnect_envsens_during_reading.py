@@ -7,6 +7,7 @@ sys.path.append('..')
 import antenvsens_monitor
 import serial
 import linecache, os
+import threading
 
 
 def line_tracer(frame, event, arg):
@@ -25,11 +26,12 @@ def line_tracer(frame, event, arg):
     return line_tracer
 
 def call_tracer(frame, event, arg):
-    if frame.f_code.co_name == 'get_data' and 'antenvsens_monitor.py' in frame.f_code.co_filename and event == 'call':
+    if frame.f_code.co_name == 'get_sensor_data' and 'antenvsens_monitor.py' in frame.f_code.co_filename and event == 'call':
         return line_tracer
     return
 
 if __name__ == '__main__':
-    sys.settrace(call_tracer)
+    # sensors are read by worker threads
+    threading.settrace(call_tracer)
     sys.argv = ['', '-g', '-v', '-o', './tmp']
     antenvsens_monitor.main()